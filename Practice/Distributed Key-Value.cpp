@@ -6,83 +6,193 @@
 #include <string>
 #include <functional>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "consistent_hash_ring.h"
+#include "key_value_store.h"
+#include "write_ahead_log.h"
+#include "snapshot.h"
+#include "rebalancer.h"
 
 
 /*
 ✅ Current Code Implements
 
-Consistent Hashing
-Thread-Safe Key-Value Store
+Consistent Hashing (weighted virtual nodes on a flat sorted ring)
+Thread-Safe Key-Value Store (or lock-free reads via ConcurrentKeyValueStore,
+or compact arena-backed entries via ArenaKeyValueStore)
+Durable Nodes (per-node write-ahead log, group commit, replay on restart)
+mmap Snapshots (serve reads from a snapshot while the store warms up)
+Online Rebalancing (keys stream to new owners after nodes join or leave)
 Basic CRUD Operations
 */
 
-// Thread-safe Key-Value Store with Consistent Hashing
-class KeyValueStore {
+// Consistent Hashing Implementation; Store is KeyValueStore or ConcurrentKeyValueStore
+template <typename Store = KeyValueStore>
+class ConsistentHashing {
 private:
-    std::unordered_map<std::string, std::string> store;
-    mutable std::shared_mutex rw_mutex; // Read-Write Lock
+    HashRing ring; // Virtual node positions mapped to node ids
+    std::vector<std::unique_ptr<Store>> nodeStores; // Store per node id
 
-public:
-    void put(const std::string& key, const std::string& value) {
-        std::unique_lock lock(rw_mutex);
-        store[key] = value;
+    std::unique_ptr<HashRing> previousRing; // Routing before the last topology change
+    std::vector<uint32_t> retiredNodes;     // Removed nodes, dropped once their keys have moved
+    Rebalancer rebalancer; // Declared after nodeStores: its job stops before they go
+
+    // Waits for the last rebalance and drops the stores it emptied
+    void settle() {
+        rebalancer.wait();
+        for (uint32_t node : retiredNodes) nodeStores[node].reset();
+        retiredNodes.clear();
     }
 
-    std::string get(const std::string& key) {
-        std::shared_lock lock(rw_mutex);
-        if (store.find(key) != store.end()) {
-            return store[key];
+    // Moves every key on the source nodes whose owner changed: copy in
+    // batches on the rebalancer thread, hand off, then delete the source copy.
+    // On a ring only the hash ranges whose owner changed are moved, and
+    // only the nodes that owned one of them are read.
+    void rebalanceFrom(std::vector<uint32_t> sources) {
+        std::vector<bool> owned(nodeStores.size(), false); // Owned a moved range before the change
+        auto ranges = HashRing::movedRanges(*previousRing, ring, [&](uint64_t hash) {
+            uint32_t before = HashRing::NO_NODE, after = HashRing::NO_NODE;
+            previousRing->replicasForHash(hash, &before, 1);
+            ring.replicasForHash(hash, &after, 1);
+            if (before != after && before != HashRing::NO_NODE) owned[before] = true;
+            return before != after;
+        });
+        if (ranges) {
+            sources.erase(std::remove_if(sources.begin(), sources.end(), [&](uint32_t node) { return !owned[node]; }),
+                          sources.end());
         }
-        return "Key Not Found";
+        if (sources.empty()) return;
+        rebalancer.start([this, sources, ranges = std::move(ranges)] {
+            std::vector<std::pair<uint32_t, std::vector<std::string>>> moved;
+            for (uint32_t source : sources) {
+                Store& from = *nodeStores[source];
+                std::vector<std::string> moving;
+                from.forEach([&](std::string_view key, std::string_view) {
+                    if (ranges && !HashRing::inRanges(*ranges, ring.hashKey(key))) return;
+                    if (ring.nodeFor(key) != source) moving.emplace_back(key);
+                });
+                rebalancer.copyAll(moving, [&](const std::string& key) {
+                    auto value = from.tryGet(key);
+                    if (value) nodeStores[ring.nodeFor(key)]->put(key, *value);
+                    return value.has_value();
+                });
+                moved.emplace_back(source, std::move(moving));
+            }
+            rebalancer.finish();
+            for (auto& [source, keys] : moved) {
+                if (!ring.isLive(source)) continue; // Retired: the whole store goes in settle()
+                for (const auto& key : keys) nodeStores[source]->remove(key);
+            }
+        });
     }
 
-    void remove(const std::string& key) {
-        std::unique_lock lock(rw_mutex);
-        store.erase(key);
+    std::vector<uint32_t> liveNodesExcept(uint32_t skip) const {
+        std::vector<uint32_t> nodes;
+        for (uint32_t node = 0; node < nodeStores.size(); ++node) {
+            if (node != skip && nodeStores[node] && ring.isLive(node)) nodes.push_back(node);
+        }
+        return nodes;
     }
-};
 
-// Consistent Hashing Implementation
-class ConsistentHashing {
-private:
-    std::map<int, std::string> ring; // Virtual node positions mapped to nodes
-    std::hash<std::string> hashFunc; // Hash function for keys
-    std::unordered_map<std::string, KeyValueStore> nodeStores; // Store per node
+    // A null store keeps the one the node already has
+    void addStore(const std::string& nodeName, int weight, std::unique_ptr<Store> store) {
+        settle();
+        previousRing = std::make_unique<HashRing>(ring);
+        uint32_t node = ring.addNode(nodeName, weight * HashRing::VIRTUAL_NODES_PER_WEIGHT);
+        if (node >= nodeStores.size()) nodeStores.resize(node + 1);
+        if (store) nodeStores[node] = std::move(store);
+        rebalanceFrom(liveNodesExcept(node));
+    }
 
 public:
-    void addNode(const std::string& nodeName) {
-        int hash = hashFunc(nodeName);
-        ring[hash] = nodeName;
-        nodeStores[nodeName] = KeyValueStore(); // Create store for the node
+    // Swap the key -> node routing (ring, jump hash, maglev table)
+    void setRoutingStrategy(std::unique_ptr<RoutingStrategy> strategy) {
+        ring.setStrategy(std::move(strategy));
+    }
+
+    // weight scales the node's share of the keyspace (e.g. by capacity)
+    // Keys the new node now owns are streamed to it in the background
+    void addNode(const std::string& nodeName, int weight = 1) {
+        settle(); // A retired store would otherwise be dropped after this check
+        uint32_t node = ring.indexOf(nodeName);
+        bool hasStore = node != HashRing::NO_NODE && node < nodeStores.size() && nodeStores[node];
+        addStore(nodeName, weight, hasStore ? nullptr : std::make_unique<Store>()); // Create store for the node
+    }
+
+    // For stores that need construction arguments (e.g. a log path)
+    void addNode(const std::string& nodeName, std::unique_ptr<Store> store, int weight = 1) {
+        addStore(nodeName, weight, std::move(store));
+    }
+
+    // The node's keys are streamed to their new owners in the background;
+    // until then reads that miss fall back to it
+    void removeNode(const std::string& nodeName) {
+        settle();
+        uint32_t node = ring.indexOf(nodeName);
+        if (node == HashRing::NO_NODE || !ring.isLive(node)) return;
+        previousRing = std::make_unique<HashRing>(ring);
+        ring.removeNode(nodeName);
+        retiredNodes.push_back(node);
+        rebalanceFrom({node});
+    }
+
+    void waitForRebalance() { settle(); }
+
+    RebalanceStats rebalanceStats() const { return rebalancer.stats(); }
+
+    // Hot path: compact node id, no string copies
+    uint32_t getNodeId(std::string_view key) const {
+        return ring.nodeFor(key);
     }
 
     std::string getNode(const std::string& key) {
-        int keyHash = hashFunc(key);
-        auto it = ring.lower_bound(keyHash);
-        if (it == ring.end()) {
-            return ring.begin()->second; // Wrap around to first node
-        }
-        return it->second;
+        uint32_t node = getNodeId(key);
+        return node == HashRing::NO_NODE ? "No Available Nodes" : ring.nodeName(node);
     }
 
     void put(const std::string& key, const std::string& value) {
-        std::string node = getNode(key);
-        nodeStores[node].put(key, value);
+        uint32_t node = getNodeId(key);
+        if (node == HashRing::NO_NODE) return;
+        rebalancer.noteWrite(key);
+        nodeStores[node]->put(key, value);
+    }
+
+    // Single probe, no sentinel string: nullopt on a miss. While a
+    // rebalance is moving keys, a miss also asks the key's previous owner.
+    std::optional<std::string> tryGet(std::string_view key) {
+        uint32_t node = getNodeId(key);
+        if (node == HashRing::NO_NODE) return std::nullopt;
+        if (auto value = nodeStores[node]->tryGet(key)) return value;
+        return rebalancer.readOld(key, [&]() -> std::optional<std::string> {
+            uint32_t old = previousRing->nodeFor(key);
+            if (old == node || old == HashRing::NO_NODE || !nodeStores[old]) return std::nullopt;
+            return nodeStores[old]->tryGet(key);
+        });
     }
 
     std::string get(const std::string& key) {
-        std::string node = getNode(key);
-        return nodeStores[node].get(key);
+        return tryGet(key).value_or("Key Not Found");
     }
 
     void remove(const std::string& key) {
-        std::string node = getNode(key);
-        nodeStores[node].remove(key);
+        uint32_t node = getNodeId(key);
+        if (node == HashRing::NO_NODE) return;
+        rebalancer.noteWrite(key);
+        nodeStores[node]->remove(key);
+    }
+
+    // Dumps one node's store to a snapshot file (see snapshot.h)
+    bool saveSnapshot(const std::string& nodeName, const std::string& path) {
+        uint32_t node = ring.indexOf(nodeName);
+        if (node == HashRing::NO_NODE || !ring.isLive(node)) return false;
+        return ::saveSnapshot(*nodeStores[node], path);
     }
 };
 
 int main() {
-    ConsistentHashing ch;
+    ConsistentHashing<> ch;
     ch.addNode("NodeA");
     ch.addNode("NodeB");
     ch.addNode("NodeC");
@@ -91,11 +201,73 @@ int main() {
     ch.put("user2", "Bob");
 
     std::cout << "Get user1: " << ch.get("user1") << std::endl;
+    if (auto value = ch.tryGet(std::string_view("user2"))) std::cout << "tryGet user2: " << *value << std::endl;
     ch.remove("user1");
     std::cout << "Get user1 after delete: " << ch.get("user1") << std::endl;
     
     std::cout << "Key 'user1' assigned to: " << ch.getNode("user1") << std::endl;
     std::cout << "Key 'user2' assigned to: " << ch.getNode("user2") << std::endl;
+
+    // Topology changes: keys stream to their new owners while reads keep working
+    for (int i = 0; i < 2000; ++i) ch.put("item" + std::to_string(i), std::to_string(i));
+    ch.addNode("NodeD");
+    int readable = 0;
+    for (int i = 0; i < 2000; ++i) readable += ch.tryGet("item" + std::to_string(i)).has_value();
+    ch.removeNode("NodeB");
+    for (int i = 0; i < 2000; ++i) readable += ch.tryGet("item" + std::to_string(i)).has_value();
+    ch.waitForRebalance();
+    for (int i = 0; i < 2000; ++i) readable += ch.tryGet("item" + std::to_string(i)).has_value();
+    RebalanceStats moves = ch.rebalanceStats();
+    std::cout << "Rebalance: " << readable << "/6000 reads served, " << moves.movedKeys << " keys moved in "
+              << moves.batches << " batches" << std::endl;
+
+    // Same API with the concurrent store: readers never block on writers
+    ConsistentHashing<ConcurrentKeyValueStore> concurrent;
+    concurrent.addNode("NodeA");
+    concurrent.addNode("NodeB");
+    std::atomic<int> hits{0};
+    std::vector<std::thread> workers;
+    workers.emplace_back([&] {
+        for (int i = 0; i < 10000; ++i) concurrent.put("key" + std::to_string(i % 100), std::to_string(i));
+    });
+    for (int t = 0; t < 3; ++t) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < 10000; ++i) {
+                if (concurrent.get("key" + std::to_string(i % 100)) != "Key Not Found") hits++;
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    std::cout << "Concurrent store: " << hits << " hits, key42 = " << concurrent.get("key42") << std::endl;
+
+    ConsistentHashing<ArenaKeyValueStore> compact;
+    compact.addNode("NodeA");
+    compact.put("user1", "Alice");
+    compact.put("user2", std::string(100, 'x')); // Too long to inline, goes to the arena
+    std::cout << "Arena store: user1 = " << compact.get("user1")
+              << ", user2 length = " << compact.get("user2").size() << std::endl;
+
+    // Durable node: a second instance over the same log recovers the data
+    std::string walPath = "/tmp/NodeA.wal";
+    std::remove(walPath.c_str());
+    {
+        ConsistentHashing<DurableKeyValueStore> durable;
+        durable.addNode("NodeA", std::make_unique<DurableKeyValueStore>(walPath, Durability::GROUP_COMMIT));
+        durable.put("user1", "Alice");
+        durable.put("user2", "Bob");
+        durable.remove("user2");
+    }
+    ConsistentHashing<DurableKeyValueStore> restarted;
+    restarted.addNode("NodeA", std::make_unique<DurableKeyValueStore>(walPath));
+    std::cout << "After restart: user1 = " << restarted.get("user1")
+              << ", user2 = " << restarted.get("user2") << std::endl;
+
+    // Warm restart: the snapshot answers reads while the store refills
+    std::string snapshotPath = "/tmp/NodeA.snap";
+    concurrent.saveSnapshot(concurrent.getNode("key42"), snapshotPath);
+    ConsistentHashing<WarmingStore<ConcurrentKeyValueStore>> warm;
+    warm.addNode("NodeA", std::make_unique<WarmingStore<ConcurrentKeyValueStore>>(snapshotPath));
+    std::cout << "Warm restart: key42 = " << warm.get("key42") << std::endl;
     
     return 0;
 }
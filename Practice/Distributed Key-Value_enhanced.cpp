@@ -7,120 +7,735 @@
 #include <functional>
 #include <map>
 #include <set>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "consistent_hash_ring.h"
+#include "key_value_store.h"
+#include "write_ahead_log.h"
+#include "replication.h"
+#include "rebalancer.h"
+#include "anti_entropy.h"
 
 const int REPLICA_COUNT = 2; // Number of replicas for each key
+const int KEY_LOCK_STRIPES = 64; // Orders inline writes, repairs and replica enqueues per key
+const int PREFERENCE_LIST_LENGTH = 8; // Replicas plus stand-ins for hinted handoff
 
-// Thread-safe Key-Value Store with Consistent Hashing
-class KeyValueStore {
+// Consistent Hashing Implementation with Replication and Fault Tolerance;
+// Store is KeyValueStore or ConcurrentKeyValueStore.
+// Under ReplicationMode::ASYNC the caller writes only the primary replica;
+// the other replicas are fed by per-node ReplicationWorkers, and a write
+// returns once writeQuorum replicas (primary included) have applied it.
+// Stored values are VersionedValues and deletes are tombstones, so
+// quorumGet can pick the newest of several replicas' answers.
+// Adding or removing a node streams the affected keys to their new
+// replicas in the background; reads that miss meanwhile ask the old ones.
+// While a node is failed its replica writes are kept as hints on stand-in
+// nodes further along each key's preference list; recovery replays them
+// and a Merkle-tree comparison repairs whatever the hints missed.
+template <typename Store = KeyValueStore>
+class ConsistentHashing {
 private:
-    std::unordered_map<std::string, std::string> store;
-    mutable std::shared_mutex rw_mutex; // Read-Write Lock
+    HashRing ring; // Virtual node positions mapped to node ids
+    std::vector<std::unique_ptr<Store>> nodeStores; // Store per node id
+    std::vector<bool> failedNodes; // Track failed nodes by id
+    std::vector<std::unique_ptr<HintLog>> hints; // Hints each node holds for failed replicas, by node id
+    size_t hintLimit = 1 << 16; // Per holder
 
-public:
-    void put(const std::string& key, const std::string& value) {
-        std::unique_lock lock(rw_mutex);
-        store[key] = value;
+    ReplicationMode replicationMode;
+    // Declared after nodeStores so workers drain before the stores go away
+    std::vector<std::unique_ptr<ReplicationWorker<Store>>> replicators; // By node id, ASYNC only
+    std::mutex keyLocks[KEY_LOCK_STRIPES];
+
+    std::atomic<uint64_t> nextVersion{1}; // Seeded past every attached store's records
+    LatencyTracker readLatency; // Replica read latency, for the hedge delay
+    std::vector<int> nodeDelayMicros; // Injected read latency by node id (testing)
+    std::once_flag executorStarted;
+    std::unique_ptr<ReadExecutor> readExecutor; // Replica reads for quorumGet; started on first use
+
+    std::unique_ptr<HashRing> previousRing; // Routing before the last topology change
+    std::vector<uint32_t> retiredNodes;     // Removed nodes, dropped once their keys have moved
+    Rebalancer rebalancer; // Declared last: its job stops before the stores and workers go
+
+    bool isAvailable(uint32_t node) const {
+        return ring.isLive(node) && !failedNodes[node];
     }
 
-    std::string get(const std::string& key) {
-        std::shared_lock lock(rw_mutex);
-        if (store.find(key) != store.end()) {
-            return store[key];
+    void attachStore(uint32_t node, std::unique_ptr<Store> store) {
+        if (node >= nodeStores.size()) {
+            nodeStores.resize(node + 1);
+            failedNodes.resize(node + 1, false);
+            replicators.resize(node + 1);
+            nodeDelayMicros.resize(node + 1, 0);
+            hints.resize(node + 1);
+        }
+        if (!hints[node]) hints[node] = std::make_unique<HintLog>(hintLimit);
+        replicators[node].reset(); // Drain writes queued for the old store
+        nodeStores[node] = std::move(store);
+        failedNodes[node] = false;
+        uint64_t highest = 0; // A reopened store may hold versions from before a restart
+        nodeStores[node]->forEach([&](std::string_view, std::string_view stored) {
+            highest = std::max(highest, VersionedValue::decode(stored).version);
+        });
+        if (highest > 0) versionAbove(highest);
+        if (replicationMode == ReplicationMode::ASYNC) {
+            replicators[node] = std::make_unique<ReplicationWorker<Store>>(*nodeStores[node]);
+        }
+    }
+
+    // Replica set for key, primary first. An unavailable replica is swapped
+    // for the next available node further along the key's preference list,
+    // and hintFor[i] names the replica that target stands in for (NO_NODE
+    // for a direct replica). Stand-ins differ per key, so an outage spreads
+    // its hints over the ring instead of onto one backup node.
+    int writeTargets(std::string_view key, uint32_t* targets, uint32_t* hintFor) {
+        uint32_t preference[PREFERENCE_LIST_LENGTH];
+        int listed = ring.replicasFor(key, preference, PREFERENCE_LIST_LENGTH);
+        int replicas = std::min(listed, REPLICA_COUNT), next = replicas, n = 0;
+        for (int i = 0; i < replicas; ++i) {
+            if (isAvailable(preference[i])) {
+                targets[n] = preference[i];
+                hintFor[n++] = HashRing::NO_NODE;
+                continue;
+            }
+            while (next < listed && !isAvailable(preference[next])) ++next;
+            if (next == listed) continue; // No stand-in left: anti-entropy repairs it on recovery
+            targets[n] = preference[next++];
+            hintFor[n++] = preference[i];
         }
-        return "Key Not Found";
+        return n;
     }
 
-    void remove(const std::string& key) {
-        std::unique_lock lock(rw_mutex);
-        store.erase(key);
+    // Leaves stored as a hint on every stand-in target and drops those from
+    // targets; returns how many direct targets are left, primary first
+    int handOff(const std::string& key, const std::string& stored, uint32_t* targets, const uint32_t* hintFor, int count) {
+        int direct = 0;
+        for (int i = 0; i < count; ++i) {
+            if (hintFor[i] == HashRing::NO_NODE) targets[direct++] = targets[i];
+            else hints[targets[i]]->add(hintFor[i], key, stored);
+        }
+        return direct;
     }
-};
 
-// Consistent Hashing Implementation with Replication and Fault Tolerance
-class ConsistentHashing {
-private:
-    std::map<int, std::string> ring; // Virtual node positions mapped to nodes
-    std::hash<std::string> hashFunc; // Hash function for keys
-    std::unordered_map<std::string, KeyValueStore> nodeStores; // Store per node
-    std::set<std::string> failedNodes; // Track failed nodes
+    static uint64_t versionOf(const std::string& stored) {
+        return VersionedValue::decode(stored).version;
+    }
+
+    // Next version of the clock, raised above floor first if it is behind
+    uint64_t versionAbove(uint64_t floor) {
+        uint64_t next = nextVersion.load(), version;
+        do {
+            version = std::max(next, floor + 1);
+        } while (!nextVersion.compare_exchange_weak(next, version + 1));
+        return version;
+    }
+
+    // Version for a new write of key. Called under keyLock(key), so the
+    // versions of a key rise in the order its writes are applied, and above
+    // the record on its first direct target, so a write can't lose to one a
+    // replica already holds (e.g. from a clock that ran further before).
+    uint64_t versionFor(const std::string& key, const uint32_t* targets, const uint32_t* hintFor, int count) {
+        uint64_t floor = 0;
+        for (int i = 0; i < count; ++i) {
+            if (hintFor[i] != HashRing::NO_NODE) continue;
+            if (auto existing = nodeStores[targets[i]]->tryGet(key)) floor = versionOf(*existing);
+            break;
+        }
+        return versionAbove(floor);
+    }
+
+    // Value of an encoded record, nullopt for none or a tombstone
+    static std::optional<std::string> liveValue(const std::optional<std::string>& stored) {
+        if (!stored) return std::nullopt;
+        VersionedValue v = VersionedValue::decode(*stored);
+        if (v.deleted) return std::nullopt;
+        return std::move(v.value);
+    }
+
+    // Under the key's lock, so a client write cannot land between the
+    // version check and the put and then be overwritten by an older record
+    // False if the node's store refused the write (e.g. a WAL failure)
+    bool putOn(uint32_t node, const std::string& key, const std::string& stored) {
+        return replication::applied([&] { return nodeStores[node]->put(key, stored); });
+    }
+
+    bool putManyOn(uint32_t node, const std::vector<std::pair<std::string, std::string>>& entries,
+                   const std::vector<uint32_t>& indices) {
+        return replication::applied([&] { return nodeStores[node]->putMany(entries, indices); });
+    }
+
+    bool putIfNewer(uint32_t node, const std::string& key, const std::string& stored) {
+        std::lock_guard lock(keyLock(key));
+        auto existing = nodeStores[node]->tryGet(key);
+        if (existing && versionOf(*existing) >= versionOf(stored)) return false;
+        return putOn(node, key, stored);
+    }
+
+    // Newest hint held for key's unavailable replicas, for keys whose
+    // available replicas have no record of it
+    std::optional<std::string> readHinted(std::string_view key) {
+        uint32_t targets[REPLICA_COUNT], hintFor[REPLICA_COUNT];
+        int count = writeTargets(key, targets, hintFor);
+        std::optional<std::string> newest;
+        for (int i = 0; i < count; ++i) {
+            if (hintFor[i] == HashRing::NO_NODE) continue;
+            auto stored = hints[targets[i]]->find(hintFor[i], key);
+            if (stored && (!newest || versionOf(*stored) > versionOf(*newest))) newest = std::move(stored);
+        }
+        return newest;
+    }
+
+    // Merkle comparison of the keys both a and b replicate. Only the
+    // entries of differing leaf ranges are exchanged, and each key's newer
+    // version is written to the side that is missing it or has an older
+    // one. The entries are a snapshot, so the write goes through
+    // putIfNewer(): a client write made since then is not rolled back.
+    void repairPair(uint32_t a, uint32_t b, RepairStats& stats) {
+        uint32_t nodes[2] = {a, b};
+        auto shared = [&](std::string_view key) {
+            return inReplicaSet(ring, key, a) && inReplicaSet(ring, key, b);
+        };
+        MerkleTree trees[2];
+        for (int side = 0; side < 2; ++side) {
+            nodeStores[nodes[side]]->forEach([&](std::string_view key, std::string_view stored) {
+                if (shared(key)) trees[side].add(ring.hashKey(key), key, stored);
+            });
+            trees[side].seal();
+        }
+        std::vector<uint32_t> differing = MerkleTree::diff(trees[0], trees[1], &stats.rangesCompared);
+        if (differing.empty()) return;
+        stats.rangesRepaired += differing.size();
+
+        std::vector<bool> inRange(MerkleTree::LEAVES, false);
+        for (uint32_t leaf : differing) inRange[leaf] = true;
+        std::unordered_map<std::string, std::string> entries[2];
+        for (int side = 0; side < 2; ++side) {
+            nodeStores[nodes[side]]->forEach([&](std::string_view key, std::string_view stored) {
+                if (inRange[MerkleTree::leafOf(ring.hashKey(key))] && shared(key)) {
+                    entries[side].emplace(key, stored);
+                }
+            });
+        }
+        for (int side = 0; side < 2; ++side) {
+            for (const auto& [key, stored] : entries[side]) {
+                auto other = entries[1 - side].find(key);
+                if (other != entries[1 - side].end() && versionOf(other->second) >= versionOf(stored)) continue;
+                if (putIfNewer(nodes[1 - side], key, stored)) ++stats.keysRepaired;
+            }
+        }
+    }
+
+    std::mutex& keyLock(const std::string& key) {
+        return keyLocks[ring.hashKey(key) % KEY_LOCK_STRIPES];
+    }
+
+    // Versions a value (or a tombstone) and writes it or its hints to
+    // key's replicas. Hints count towards writeQuorum (a sloppy quorum);
+    // a copy a replica's store refused does not. False if the quorum (SYNC:
+    // every copy) was not reached or no node could take the write.
+    bool write(const std::string& key, bool deleted, const std::string& value, int writeQuorum) {
+        uint32_t targets[REPLICA_COUNT], hintFor[REPLICA_COUNT];
+        int count = writeTargets(key, targets, hintFor);
+        if (count == 0) return false;
+        rebalancer.noteWrite(key); // Before the key lock, which a rebalance copy takes under its own
+        int waitFor;
+        std::shared_ptr<WriteAck> ack;
+        {
+            std::lock_guard lock(keyLock(key));
+            std::string stored = VersionedValue::encode(versionFor(key, targets, hintFor, count), deleted, value);
+            int direct = handOff(key, stored, targets, hintFor, count);
+            if (replicationMode == ReplicationMode::SYNC) {
+                int applied = 0;
+                for (int i = 0; i < direct; ++i) applied += putOn(targets[i], key, stored);
+                return applied == direct;
+            }
+            if (direct == 0) return true;
+            waitFor = std::min(writeQuorum, count) - (count - direct) - putOn(targets[0], key, stored);
+            if (waitFor > 0 && direct > 1) ack = std::make_shared<WriteAck>(direct - 1);
+            for (int i = 1; i < direct; ++i) replicators[targets[i]]->enqueuePut(key, stored, ack);
+        }
+        return waitFor <= 0 || (ack && ack->waitFor(waitFor));
+    }
+
+    // Waits for the last rebalance and drops the stores it emptied
+    void settle() {
+        rebalancer.wait();
+        if (readExecutor) readExecutor->waitIdle(); // Hedged reads may still use a retired store
+        for (uint32_t node : retiredNodes) {
+            replicators[node].reset();
+            nodeStores[node].reset();
+            for (auto& holder : hints) {
+                if (holder) holder->take(node); // Rebalancing re-replicated its keys
+            }
+        }
+        retiredNodes.clear();
+    }
+
+    static bool inReplicaSet(const HashRing& routing, std::string_view key, uint32_t node) {
+        uint32_t replicas[REPLICA_COUNT];
+        int count = routing.replicasFor(key, replicas, REPLICA_COUNT);
+        return std::find(replicas, replicas + count, node) != replicas + count;
+    }
+
+    static bool replicaSetChanged(const HashRing& before, const HashRing& after, uint64_t keyHash) {
+        uint32_t was[REPLICA_COUNT], now[REPLICA_COUNT];
+        int count = before.replicasForHash(keyHash, was, REPLICA_COUNT);
+        return count != after.replicasForHash(keyHash, now, REPLICA_COUNT) || !std::is_permutation(was, was + count, now);
+    }
+
+    // Copies every key on the source nodes whose replica set changed to its
+    // new replicas, in batches on the rebalancer thread. A copy only lands
+    // where the target has no version of the key or an older one. After the
+    // handoff, sources that are no longer replicas of a key drop it. On a
+    // ring only the hash ranges whose replica set changed are moved, and
+    // only their old replicas are read.
+    void rebalanceFrom(std::vector<uint32_t> sources) {
+        std::vector<bool> held(nodeStores.size(), false); // Replicated a moved range before the change
+        auto ranges = HashRing::movedRanges(*previousRing, ring, [&](uint64_t hash) {
+            if (!replicaSetChanged(*previousRing, ring, hash)) return false;
+            uint32_t was[REPLICA_COUNT];
+            int count = previousRing->replicasForHash(hash, was, REPLICA_COUNT);
+            for (int i = 0; i < count; ++i) held[was[i]] = true;
+            return true;
+        });
+        if (ranges) {
+            sources.erase(std::remove_if(sources.begin(), sources.end(), [&](uint32_t node) { return !held[node]; }),
+                          sources.end());
+        }
+        if (sources.empty()) return;
+        waitForReplication(); // Sources must hold every acknowledged write
+        rebalancer.start([this, sources, ranges = std::move(ranges)] {
+            std::vector<std::pair<uint32_t, std::vector<std::string>>> moved;
+            for (uint32_t source : sources) {
+                Store& from = *nodeStores[source];
+                std::vector<std::string> moving;
+                from.forEach([&](std::string_view key, std::string_view) {
+                    uint64_t hash = ring.hashKey(key);
+                    if (ranges ? HashRing::inRanges(*ranges, hash) : replicaSetChanged(*previousRing, ring, hash)) {
+                        moving.emplace_back(key);
+                    }
+                });
+                rebalancer.copyAll(moving, [&](const std::string& key) {
+                    auto raw = from.tryGet(key);
+                    if (!raw) return false;
+                    uint32_t targets[REPLICA_COUNT], hintFor[REPLICA_COUNT];
+                    int count = handOff(key, *raw, targets, hintFor, writeTargets(key, targets, hintFor));
+                    bool copied = false;
+                    for (int i = 0; i < count; ++i) {
+                        if (targets[i] != source && putIfNewer(targets[i], key, *raw)) copied = true;
+                    }
+                    return copied;
+                });
+                moved.emplace_back(source, std::move(moving));
+            }
+            rebalancer.finish();
+            for (auto& [source, keys] : moved) {
+                if (!ring.isLive(source)) continue; // Retired: the whole store goes in settle()
+                for (const auto& key : keys) {
+                    if (!inReplicaSet(ring, key, source)) nodeStores[source]->remove(key);
+                }
+            }
+        });
+    }
+
+    // Newest record of key on its replicas under the previous routing, while
+    // a rebalance may not have copied it yet
+    std::optional<std::string> readPrevious(std::string_view key) {
+        return rebalancer.readOld(key, [&]() -> std::optional<std::string> {
+            uint32_t replicas[REPLICA_COUNT];
+            int count = previousRing->replicasFor(key, replicas, REPLICA_COUNT);
+            std::optional<std::string> newest;
+            for (int i = 0; i < count; ++i) {
+                if (replicas[i] >= nodeStores.size() || !nodeStores[replicas[i]]) continue;
+                auto raw = nodeStores[replicas[i]]->tryGet(key);
+                if (raw && (!newest || versionOf(*raw) > versionOf(*newest))) newest = std::move(raw);
+            }
+            return newest;
+        });
+    }
+
+    std::vector<uint32_t> liveNodesExcept(uint32_t skip) const {
+        std::vector<uint32_t> nodes;
+        for (uint32_t node = 0; node < nodeStores.size(); ++node) {
+            if (node != skip && nodeStores[node] && isAvailable(node)) nodes.push_back(node);
+        }
+        return nodes;
+    }
+
+    void addStore(const std::string& nodeName, int weight, std::unique_ptr<Store> store) {
+        settle();
+        previousRing = std::make_unique<HashRing>(ring);
+        uint32_t node = ring.addNode(nodeName, weight * HashRing::VIRTUAL_NODES_PER_WEIGHT);
+        attachStore(node, std::move(store));
+        rebalanceFrom(liveNodesExcept(node));
+    }
+
+    // Answers gathered by one quorumGet; outlives the call if a hedge loses
+    struct ReadRound {
+        std::mutex m;
+        std::condition_variable cv;
+        int responses = 0;
+        bool done = false;     // Caller has its quorum; queued reads can be skipped
+        VersionedValue newest; // version 0: no replica has the key
+    };
+
+    void readReplica(uint32_t node, const std::string& key, const std::shared_ptr<ReadRound>& round) {
+        Store* store = nodeStores[node].get();
+        int delayMicros = nodeDelayMicros[node];
+        readExecutor->submit([this, store, delayMicros, key, round] {
+            {
+                std::lock_guard lock(round->m);
+                if (round->done) return;
+            }
+            auto start = std::chrono::steady_clock::now();
+            if (delayMicros > 0) std::this_thread::sleep_for(std::chrono::microseconds(delayMicros));
+            std::optional<std::string> raw = store->tryGet(key);
+            readLatency.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+            VersionedValue answer = raw ? VersionedValue::decode(*raw) : VersionedValue{};
+            {
+                std::lock_guard lock(round->m);
+                ++round->responses;
+                if (answer.version > round->newest.version) round->newest = std::move(answer);
+            }
+            round->cv.notify_all();
+        });
+    }
 
 public:
-    void addNode(const std::string& nodeName) {
-        int hash = hashFunc(nodeName);
-        ring[hash] = nodeName;
-        nodeStores[nodeName] = KeyValueStore(); // Create store for the node
+    explicit ConsistentHashing(ReplicationMode mode = ReplicationMode::SYNC) : replicationMode(mode) {}
+
+    // Swap the key -> node routing (ring, jump hash, maglev table)
+    void setRoutingStrategy(std::unique_ptr<RoutingStrategy> strategy) {
+        ring.setStrategy(std::move(strategy));
+    }
+
+    // weight scales the node's share of the keyspace (e.g. by capacity)
+    // Keys the new node now replicates are streamed to it in the background
+    void addNode(const std::string& nodeName, int weight = 1) {
+        addStore(nodeName, weight, std::make_unique<Store>()); // Create store for the node
     }
 
+    // For stores that need construction arguments (e.g. a log path)
+    void addNode(const std::string& nodeName, std::unique_ptr<Store> store, int weight = 1) {
+        addStore(nodeName, weight, std::move(store));
+    }
+
+    // The node's keys are streamed to their new replicas in the background;
+    // until then reads that miss fall back to it
     void removeNode(const std::string& nodeName) {
-        for (auto it = ring.begin(); it != ring.end(); ) {
-            if (it->second == nodeName) {
-                it = ring.erase(it);
-            } else {
-                ++it;
+        settle();
+        uint32_t node = ring.indexOf(nodeName);
+        if (node == HashRing::NO_NODE || !ring.isLive(node)) return;
+        previousRing = std::make_unique<HashRing>(ring);
+        ring.removeNode(nodeName);
+        retiredNodes.push_back(node);
+        rebalanceFrom({node});
+    }
+
+    void waitForRebalance() { settle(); }
+
+    // Simulated outage: the node keeps its data but serves no reads or
+    // writes, and its replica writes become hints on stand-in nodes
+    void markNodeFailed(const std::string& nodeName) {
+        uint32_t node = ring.indexOf(nodeName);
+        if (node == HashRing::NO_NODE || !ring.isLive(node)) return;
+        settle(); // A rebalance copy must not see the flag flip mid-batch
+        failedNodes[node] = true;
+    }
+
+    // Brings the node back: the hints held for it are replayed, then an
+    // anti-entropy pass against every other node repairs what the hints
+    // missed (dropped past the hint limit, or no stand-in was available)
+    RepairStats recoverNode(const std::string& nodeName) {
+        RepairStats stats;
+        uint32_t node = ring.indexOf(nodeName);
+        if (node == HashRing::NO_NODE || !ring.isLive(node) || !failedNodes[node]) return stats;
+        settle();
+        waitForReplication(); // No queued replica write may land after a newer replayed one
+        failedNodes[node] = false;
+        for (auto& holder : hints) {
+            if (!holder) continue;
+            for (const auto& [key, stored] : holder->take(node)) {
+                if (putIfNewer(node, key, stored)) ++stats.hintsReplayed;
             }
         }
-        nodeStores.erase(nodeName);
-        failedNodes.insert(nodeName);
+        for (uint32_t peer : liveNodesExcept(node)) repairPair(node, peer, stats);
+        return stats;
     }
 
-    std::string getNode(const std::string& key) {
-        int keyHash = hashFunc(key);
-        auto it = ring.lower_bound(keyHash);
-        if (it == ring.end()) {
-            return ring.begin()->second; // Wrap around to first node
+    // Merkle-tree comparison between every pair of available nodes
+    RepairStats antiEntropy() {
+        RepairStats stats;
+        settle();
+        waitForReplication();
+        std::vector<uint32_t> nodes = liveNodesExcept(HashRing::NO_NODE);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            for (size_t j = i + 1; j < nodes.size(); ++j) repairPair(nodes[i], nodes[j], stats);
         }
-        return it->second;
+        return stats;
     }
 
-    std::string getBalancedNode(const std::string& key) {
-        for (auto& [hash, node] : ring) {
-            if (failedNodes.find(node) == failedNodes.end()) {
-                return node; // Return first available node
+    // Drops tombstones every replica already agrees on, so deleted keys
+    // don't stay on every replica forever. A key is purged only when all
+    // its replicas are available and hold the same tombstone, and no hint
+    // for it is pending; otherwise a replica that missed the delete could
+    // bring the key back. Run after antiEntropy() to purge the most.
+    size_t purgeTombstones() {
+        settle();
+        waitForReplication();
+        std::set<std::string> candidates;
+        for (uint32_t node : liveNodesExcept(HashRing::NO_NODE)) {
+            nodeStores[node]->forEach([&](std::string_view key, std::string_view stored) {
+                if (VersionedValue::decode(stored).deleted) candidates.emplace(key);
+            });
+        }
+        size_t purged = 0;
+        for (const std::string& key : candidates) {
+            uint32_t replicas[REPLICA_COUNT];
+            int count = ring.replicasFor(key, replicas, REPLICA_COUNT);
+            std::lock_guard lock(keyLock(key));
+            bool agreed = count > 0;
+            uint64_t version = 0;
+            for (int i = 0; i < count && agreed; ++i) {
+                auto stored = isAvailable(replicas[i]) ? nodeStores[replicas[i]]->tryGet(key) : std::nullopt;
+                VersionedValue v = stored ? VersionedValue::decode(*stored) : VersionedValue{};
+                agreed = stored && v.deleted && (i == 0 || v.version == version);
+                version = v.version;
+                for (const auto& holder : hints) {
+                    if (agreed && holder && holder->find(replicas[i], key)) agreed = false;
+                }
             }
+            if (!agreed) continue;
+            for (int i = 0; i < count; ++i) nodeStores[replicas[i]]->remove(key);
+            ++purged;
         }
-        return "No Available Nodes";
+        return purged;
     }
 
-    void put(const std::string& key, const std::string& value) {
-        int count = 0;
-        for (auto it = ring.lower_bound(hashFunc(key)); count < REPLICA_COUNT; ++it, ++count) {
-            if (it == ring.end()) it = ring.begin(); // Wrap around
-            if (failedNodes.find(it->second) == failedNodes.end()) {
-                nodeStores[it->second].put(key, value);
-            } else {
-                std::string backupNode = getBalancedNode(key);
-                if (backupNode != "No Available Nodes") {
-                    nodeStores[backupNode].put(key, value);
-                }
+    // Per holder; past it hints are dropped and left to anti-entropy
+    void setHintLimit(size_t maxHints) {
+        hintLimit = maxHints;
+        for (auto& holder : hints) {
+            if (holder) holder->setLimit(maxHints);
+        }
+    }
+
+    // Hints nodeName holds for failed replicas
+    size_t pendingHints(const std::string& nodeName) const {
+        uint32_t node = ring.indexOf(nodeName);
+        return node == HashRing::NO_NODE || node >= hints.size() || !hints[node] ? 0 : hints[node]->size();
+    }
+
+    RebalanceStats rebalanceStats() const { return rebalancer.stats(); }
+
+    // Hot path: compact node id, no string copies
+    uint32_t getNodeId(std::string_view key) const {
+        return ring.nodeFor(key);
+    }
+
+    std::string getNode(const std::string& key) {
+        uint32_t node = getNodeId(key);
+        return node == HashRing::NO_NODE ? "No Available Nodes" : ring.nodeName(node);
+    }
+
+    // writeQuorum (ASYNC only): replicas that must apply the write before
+    // returning, primary included; 1 is fire-and-forget for the others.
+    // False if fewer than writeQuorum copies (SYNC: all) were applied.
+    bool put(const std::string& key, const std::string& value, int writeQuorum = REPLICA_COUNT) {
+        return write(key, false, value, writeQuorum);
+    }
+
+    // First replica with a record of the key (value or delete); nullopt if
+    // none has one or it was deleted
+    std::optional<std::string> tryGet(std::string_view key) {
+        uint32_t replicas[REPLICA_COUNT];
+        int count = ring.replicasFor(key, replicas, REPLICA_COUNT);
+        std::optional<std::string> raw;
+        for (int i = 0; i < count && !raw; ++i) {
+            if (isAvailable(replicas[i])) raw = nodeStores[replicas[i]]->tryGet(key);
+        }
+        if (!raw) raw = readHinted(key);
+        if (!raw) raw = readPrevious(key);
+        return liveValue(raw);
+    }
+
+    // Reads readQuorum replicas in parallel and returns the newest version
+    // among their answers. With hedge, if the quorum isn't in after the
+    // tracked hedge percentile of replica latency, the next replica is
+    // asked as well (again after each further delay), so one slow node
+    // doesn't set the read's latency.
+    std::optional<std::string> quorumGet(const std::string& key, int readQuorum = 1, bool hedge = false) {
+        uint32_t replicas[REPLICA_COUNT];
+        int count = ring.replicasFor(key, replicas, REPLICA_COUNT), live = 0;
+        for (int i = 0; i < count; ++i) {
+            if (isAvailable(replicas[i])) replicas[live++] = replicas[i];
+        }
+        if (live == 0) return liveValue(readHinted(key));
+        std::call_once(executorStarted, [this] { readExecutor = std::make_unique<ReadExecutor>(); });
+
+        int needed = std::max(1, std::min(readQuorum, live)), asked = 0;
+        auto round = std::make_shared<ReadRound>();
+        for (; asked < needed; ++asked) readReplica(replicas[asked], key, round);
+
+        std::unique_lock lock(round->m);
+        auto quorum = [&] { return round->responses >= needed; };
+        while (!quorum()) {
+            if (!hedge || asked == live) {
+                round->cv.wait(lock, quorum);
+            } else if (!round->cv.wait_for(lock, std::chrono::microseconds((long)readLatency.micros()), quorum)) {
+                readReplica(replicas[asked++], key, round); // First `needed` answers of any replicas count
             }
         }
+        round->done = true;
+        VersionedValue newest = round->newest;
+        lock.unlock();
+        if (newest.version == 0) {
+            if (auto raw = readPrevious(key)) newest = VersionedValue::decode(*raw);
+        }
+        if (newest.version == 0 || newest.deleted) return std::nullopt;
+        return newest.value;
+    }
+
+    // Percentile of replica read latency used as the hedge delay
+    void setHedgePercentile(double percentile) {
+        readLatency.setPercentile(percentile);
+    }
+
+    // Fault injection: delay every quorumGet read served by nodeName
+    void setNodeDelay(const std::string& nodeName, int micros) {
+        uint32_t node = ring.indexOf(nodeName);
+        if (node != HashRing::NO_NODE) nodeDelayMicros[node] = micros;
     }
 
     std::string get(const std::string& key) {
-        int count = 0;
-        for (auto it = ring.lower_bound(hashFunc(key)); count < REPLICA_COUNT; ++it, ++count) {
-            if (it == ring.end()) it = ring.begin(); // Wrap around
-            if (failedNodes.find(it->second) == failedNodes.end()) {
-                std::string value = nodeStores[it->second].get(key);
-                if (value != "Key Not Found") return value;
+        return tryGet(key).value_or("Key Not Found");
+    }
+
+    // Routes every key first, buckets them by owner node, then visits each
+    // node's store once per replica round. Results are in input order;
+    // misses are "Key Not Found".
+    std::vector<std::string> multiGet(const std::vector<std::string>& keys) {
+        std::vector<std::string> values(keys.size(), "Key Not Found");
+        std::vector<bool> found(keys.size(), false);
+        std::vector<uint64_t> hashes(keys.size());
+        stablehash::hashBatch(keys.data(), keys.size(), hashes.data());
+
+        std::vector<uint32_t> replicas(keys.size() * REPLICA_COUNT);
+        std::vector<int> replicaCount(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            replicaCount[i] = ring.replicasForHash(hashes[i], &replicas[i * REPLICA_COUNT], REPLICA_COUNT);
+        }
+
+        std::vector<std::vector<uint32_t>> byNode(ring.nodeCount());
+        for (int r = 0; r < REPLICA_COUNT; ++r) {
+            for (auto& bucket : byNode) bucket.clear();
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (found[i] || r >= replicaCount[i]) continue;
+                uint32_t node = replicas[i * REPLICA_COUNT + r];
+                if (isAvailable(node)) byNode[node].push_back(i);
             }
+            for (uint32_t node = 0; node < byNode.size(); ++node) {
+                if (!byNode[node].empty()) nodeStores[node]->getMany(keys, byNode[node], values, found);
+            }
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!found[i]) {
+                auto raw = readHinted(keys[i]);
+                if (!raw) raw = readPrevious(keys[i]);
+                if (!raw) continue;
+                values[i] = std::move(*raw);
+            }
+            VersionedValue v = VersionedValue::decode(values[i]);
+            values[i] = v.deleted ? "Key Not Found" : std::move(v.value);
         }
-        return "Key Not Found";
+        return values;
     }
 
-    void remove(const std::string& key) {
-        int count = 0;
-        for (auto it = ring.lower_bound(hashFunc(key)); count < REPLICA_COUNT; ++it, ++count) {
-            if (it == ring.end()) it = ring.begin(); // Wrap around
-            if (failedNodes.find(it->second) == failedNodes.end()) {
-                nodeStores[it->second].remove(key);
+    // Batched put, one key stripe at a time under that stripe's lock so no
+    // single-key write or repair interleaves with the batch; each node's
+    // lock is taken once per stripe. Under ASYNC only the primaries are
+    // written inline. Versions are assigned under the stripe lock, as in
+    // put(). False unless every entry met the quorum put() asks.
+    bool multiPut(const std::vector<std::pair<std::string, std::string>>& batch, int writeQuorum = REPLICA_COUNT) {
+        std::vector<std::pair<std::string, std::string>> entries; // Key and encoded record
+        entries.reserve(batch.size());
+        for (const auto& [key, value] : batch) entries.emplace_back(key, std::string());
+        std::vector<std::vector<uint32_t>> byNode(ring.nodeCount());
+        std::vector<uint32_t> targets(entries.size() * REPLICA_COUNT), hintFor(entries.size() * REPLICA_COUNT);
+        std::vector<int> targetCount(entries.size()), hinted(entries.size(), 0);
+        std::vector<std::vector<uint32_t>> byStripe(KEY_LOCK_STRIPES);
+        bool sync = replicationMode == ReplicationMode::SYNC, ok = true;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            targetCount[i] = writeTargets(entries[i].first, &targets[i * REPLICA_COUNT], &hintFor[i * REPLICA_COUNT]);
+            if (targetCount[i] == 0) {
+                ok = false; // No node could take it
+                continue;
+            }
+            rebalancer.noteWrite(entries[i].first);
+            byStripe[ring.hashKey(entries[i].first) % KEY_LOCK_STRIPES].push_back(i);
+        }
+        std::vector<int> applied(entries.size(), 0); // Copies written inline
+        std::vector<std::pair<std::shared_ptr<WriteAck>, int>> acks;
+        for (int stripe = 0; stripe < KEY_LOCK_STRIPES; ++stripe) {
+            if (byStripe[stripe].empty()) continue;
+            std::lock_guard lock(keyLocks[stripe]);
+            for (auto& bucket : byNode) bucket.clear();
+            for (uint32_t i : byStripe[stripe]) {
+                uint32_t* entryTargets = &targets[i * REPLICA_COUNT];
+                const uint32_t* entryHintFor = &hintFor[i * REPLICA_COUNT];
+                uint64_t version = versionFor(entries[i].first, entryTargets, entryHintFor, targetCount[i]);
+                entries[i].second = VersionedValue::encode(version, false, batch[i].second);
+                int direct = handOff(entries[i].first, entries[i].second, entryTargets, entryHintFor, targetCount[i]);
+                hinted[i] = targetCount[i] - direct;
+                targetCount[i] = direct;
+                for (int r = 0; r < (sync ? direct : std::min(direct, 1)); ++r) byNode[entryTargets[r]].push_back(i);
+            }
+            for (uint32_t node = 0; node < byNode.size(); ++node) {
+                if (byNode[node].empty() || !putManyOn(node, entries, byNode[node])) continue;
+                for (uint32_t i : byNode[node]) ++applied[i];
+            }
+            if (sync) {
+                for (uint32_t i : byStripe[stripe]) ok = ok && applied[i] == targetCount[i];
+                continue;
+            }
+            for (uint32_t i : byStripe[stripe]) {
+                int waitFor = std::min(writeQuorum, targetCount[i] + hinted[i]) - hinted[i] - applied[i];
+                std::shared_ptr<WriteAck> ack;
+                if (waitFor > 0 && targetCount[i] > 1) ack = std::make_shared<WriteAck>(targetCount[i] - 1);
+                for (int r = 1; r < targetCount[i]; ++r) {
+                    replicators[targets[i * REPLICA_COUNT + r]]->enqueuePut(entries[i].first, entries[i].second, ack);
+                }
+                if (ack) acks.emplace_back(ack, waitFor);
+                else if (waitFor > 0) ok = false;
             }
         }
+        for (auto& [ack, waitFor] : acks) ok = ack->waitFor(waitFor) && ok;
+        return ok;
+    }
+
+    // Writes a tombstone, so a replica that missed it can't win a quorum read
+    bool remove(const std::string& key, int writeQuorum = REPLICA_COUNT) {
+        return write(key, true, std::string(), writeQuorum);
+    }
+
+    // Per-replica backlog and apply lag (ASYNC only)
+    ReplicaLag replicationLag(const std::string& nodeName) {
+        uint32_t node = ring.indexOf(nodeName);
+        if (node == HashRing::NO_NODE || !replicators[node]) return ReplicaLag{};
+        return replicators[node]->lag();
+    }
+
+    // Blocks until every queued replica write has been applied
+    void waitForReplication() {
+        for (auto& replicator : replicators) {
+            if (replicator) replicator->drain();
+        }
     }
 };
 
 int main() {
-    ConsistentHashing ch;
+    ConsistentHashing<> ch;
     ch.addNode("NodeA");
     ch.addNode("NodeB");
     ch.addNode("NodeC");
@@ -134,6 +749,91 @@ int main() {
     
     std::cout << "Key 'user1' assigned to: " << ch.getNode("user1") << std::endl;
     std::cout << "Key 'user2' assigned to: " << ch.getNode("user2") << std::endl;
+
+    ch.multiPut({{"user3", "Carol"}, {"user4", "Dave"}, {"user5", "Eve"}});
+    std::vector<std::string> batch = ch.multiGet({"user2", "user3", "user4", "user5", "user1"});
+    std::cout << "multiGet:";
+    for (const auto& value : batch) std::cout << " " << value;
+    std::cout << std::endl;
+
+    // Replica writes off the caller thread: W = 1 returns after the primary's fsync
+    for (int quorum : {0, 1, REPLICA_COUNT}) {
+        ReplicationMode mode = quorum == 0 ? ReplicationMode::SYNC : ReplicationMode::ASYNC;
+        ConsistentHashing<DurableKeyValueStore> durable(mode);
+        for (std::string name : {"NodeA", "NodeB", "NodeC"}) {
+            std::string walPath = "/tmp/replication_" + name + ".wal";
+            std::remove(walPath.c_str());
+            durable.addNode(name, std::make_unique<DurableKeyValueStore>(walPath, Durability::GROUP_COMMIT));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 200; ++i) durable.put("key" + std::to_string(i), "value", std::max(quorum, 1));
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        ReplicaLag lag = durable.replicationLag("NodeB");
+        std::cout << (quorum == 0 ? "sync replication" : "async, W = " + std::to_string(quorum))
+                  << ": " << ms / 200 << " ms/put, NodeB queued " << lag.queued
+                  << ", max batch lag " << lag.maxBatchLagMs << " ms" << std::endl;
+        durable.waitForReplication();
+    }
+
+    // One slow node: plain reads of its keys wait it out, hedged reads ask the other replica
+    ConsistentHashing<ConcurrentKeyValueStore> cluster;
+    for (std::string name : {"NodeA", "NodeB", "NodeC"}) cluster.addNode(name);
+    for (int i = 0; i < 300; ++i) cluster.put("key" + std::to_string(i), "value" + std::to_string(i));
+    cluster.setNodeDelay("NodeA", 2000);
+    cluster.setHedgePercentile(0.5); // A third of reads are slow, so hedge past the median
+    for (bool hedge : {false, true}) {
+        std::vector<double> micros;
+        for (int i = 0; i < 1000; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            cluster.quorumGet("key" + std::to_string(i % 300), 1, hedge);
+            micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(micros.begin(), micros.end());
+        std::cout << (hedge ? "hedged" : "plain") << " R=1 reads: p50 " << micros[micros.size() / 2]
+                  << " us, p99 " << micros[micros.size() * 99 / 100] << " us" << std::endl;
+    }
+    cluster.remove("key7");
+    std::cout << "R=2 read of key1: " << cluster.quorumGet("key1", 2).value_or("Key Not Found")
+              << ", of deleted key7: " << cluster.quorumGet("key7", 2).value_or("Key Not Found") << std::endl;
+
+    // Topology changes: replicas are rebuilt in the background while reads keep working
+    cluster.setNodeDelay("NodeA", 0);
+    cluster.addNode("NodeD");
+    int readable = 0;
+    for (int i = 0; i < 300; ++i) readable += cluster.quorumGet("key" + std::to_string(i), 2).has_value();
+    cluster.removeNode("NodeB");
+    for (int i = 0; i < 300; ++i) readable += cluster.tryGet("key" + std::to_string(i)).has_value();
+    cluster.waitForRebalance();
+    for (int i = 0; i < 300; ++i) readable += cluster.quorumGet("key" + std::to_string(i), 2).has_value();
+    RebalanceStats moves = cluster.rebalanceStats();
+    std::cout << "Rebalance: " << readable << "/897 reads served (key7 deleted), " << moves.movedKeys
+              << " keys copied in " << moves.batches << " batches" << std::endl;
+
+    // Outage: NodeB's replica writes become hints spread over the other nodes.
+    // Recovery replays them; anti-entropy repairs the ones dropped past the limit.
+    ConsistentHashing<ConcurrentKeyValueStore> outage;
+    std::vector<std::string> names = {"NodeA", "NodeB", "NodeC", "NodeD", "NodeE"};
+    for (const auto& name : names) outage.addNode(name);
+    for (int i = 0; i < 1000; ++i) outage.put("key" + std::to_string(i), "v1");
+    outage.setHintLimit(100);
+    outage.markNodeFailed("NodeB");
+    for (int i = 0; i < 1000; ++i) outage.put("key" + std::to_string(i), "v2");
+    std::cout << "Hints held while NodeB is down:";
+    for (const auto& name : names) {
+        if (name != "NodeB") std::cout << " " << name << "=" << outage.pendingHints(name);
+    }
+    RepairStats repair = outage.recoverNode("NodeB");
+    std::cout << std::endl << "NodeB recovered: " << repair.hintsReplayed << " hints replayed, "
+              << repair.keysRepaired << " keys repaired in " << repair.rangesRepaired << " ranges ("
+              << repair.rangesCompared << " digests compared); next pass finds "
+              << outage.antiEntropy().rangesRepaired << " differing ranges" << std::endl;
+
+    // Deletes leave tombstones on every replica until all replicas agree on them
+    for (int i = 0; i < 100; ++i) outage.remove("key" + std::to_string(i));
+    outage.antiEntropy();
+    size_t purged = outage.purgeTombstones();
+    std::cout << "Purged " << purged << "/100 tombstones; key5 = " << outage.get("key5")
+              << ", key500 = " << outage.get("key500") << std::endl;
     
     return 0;
 }
@@ -1,51 +1,543 @@
 /*
 💡 Key Features Implemented
-✅ Distributed LRU Cache using Consistent Hashing
+✅ Distributed LRU Cache using Consistent Hashing (weighted virtual nodes)
 ✅ Automatic Failover (Nodes are Removed on Failure)
 ✅ Replication for Fault Tolerance (REPLICA_COUNT = 2)
-✅ Cache Miss Handling via Persistent Storage
+✅ Cache Miss Handling via Persistent Storage (read-through over a local LSM store)
 ✅ Thread-Safe Cache with Shared and Exclusive Locks
 ✅ Load Balancer for Client Routing
+✅ Sharded, Lock-Striped LRU Cache (per-shard lock, list and map)
+✅ Allocation-Free Slab LRU (index-linked nodes + open-addressing table)
+✅ CLOCK Eviction Policy (hits set a reference bit under a shared lock)
+✅ TinyLFU Admission Filter (aging count-min sketch) + Hit/Miss Counters
+✅ mmap Snapshots for Fast Node Warm-Up (LRU order preserved)
+✅ Single-Flight Misses (concurrent misses on a key share one storage read)
+✅ Per-Key TTL (inline deadline on a coarse clock; expired entries evicted first)
 */
 
 
+#include <iostream>
+#include <string>
+#include <cstdint>
 #include <list>
+#include <vector>
+#include <memory>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
 #include <shared_mutex>
 #include <map>
+#include <set>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <queue>
+#include "consistent_hash_ring.h"
+#include "coarse_clock.h"
+#include "snapshot.h"
+#include "lsm_store.h"
 
 
 using namespace std;
 
 
+/*
+Count-min sketch of recent access frequency, used as a TinyLFU admission
+filter. Four rows of saturating 4-bit counters (stored one per byte);
+after sampleSize increments every counter is halved so the sketch tracks
+recent popularity rather than all-time counts. Counters are relaxed
+atomics so CLOCK readers can record hits under a shared lock; a lost
+update only makes the estimate slightly more approximate.
+*/
+
+class FrequencySketch {
+private:
+    static constexpr int DEPTH = 4;
+    static constexpr uint8_t MAX_COUNT = 15;
+
+    vector<atomic<uint8_t>> counters;
+    size_t mask;
+    uint64_t sampleSize;
+    atomic<uint64_t> additions{0};
+
+    size_t indexOf(size_t h, int row) const {
+        uint64_t h2 = (h >> 32) | 1;
+        return (row * (mask + 1)) + ((h + row * h2) & mask);
+    }
+
+    void age() {
+        for (auto &c : counters) c.store(c.load(memory_order_relaxed) >> 1, memory_order_relaxed);
+    }
+
+public:
+    FrequencySketch(int capacity) {
+        size_t width = 16;
+        while (width < (size_t)capacity * 4) width <<= 1;
+        counters = vector<atomic<uint8_t>>(width * DEPTH);
+        mask = width - 1;
+        sampleSize = 10ULL * max(1, capacity);
+    }
+
+    void increment(size_t h) {
+        for (int row = 0; row < DEPTH; ++row) {
+            atomic<uint8_t> &c = counters[indexOf(h, row)];
+            uint8_t cur = c.load(memory_order_relaxed);
+            while (cur < MAX_COUNT && !c.compare_exchange_weak(cur, cur + 1, memory_order_relaxed)) {}
+        }
+        if (additions.fetch_add(1, memory_order_relaxed) + 1 == sampleSize) {
+            additions.store(0, memory_order_relaxed);
+            age();
+        }
+    }
+
+    int estimate(size_t h) const {
+        int freq = MAX_COUNT;
+        for (int row = 0; row < DEPTH; ++row) {
+            freq = min<int>(freq, counters[indexOf(h, row)].load(memory_order_relaxed));
+        }
+        return freq;
+    }
+};
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t rejected = 0; // New keys refused by the admission filter
+    uint64_t expired = 0;  // Entries dropped or evicted after their TTL
+
+    double hitRatio() const {
+        return hits + misses == 0 ? 0.0 : (double)hits / (hits + misses);
+    }
+};
+
+enum class EvictionPolicy {
+    LRU,   // Exact recency order; every hit reorders the list
+    CLOCK  // Approximate LRU; hits only set a reference bit
+};
+
+// Entries put with a TTL carry their deadline inline and are checked
+// against CoarseClock, so no lookup calls a clock. An expired entry reads
+// as a miss and is the first choice of victim when a shard is full: each
+// shard keeps a min-heap of (deadline, key) to find the earliest one.
 class LRUCache {
 private:
-    int capacity;
-    list<pair<string, string>> cache; // Stores key-value pairs
-    unordered_map<string, list<pair<string, string>>::iterator> cacheMap;
-    mutable shared_mutex cacheMutex;
+    struct CacheEntry {
+        string key;
+        string value;
+        uint64_t expiresAt = 0; // CoarseClock deadline; 0 = no TTL
+    };
+
+    // CLOCK slot: the reference bit is the only thing a hit writes, so it
+    // is atomic and readers can share the shard lock.
+    struct ClockEntry {
+        string key;
+        string value;
+        uint64_t expiresAt = 0;
+        atomic<bool> referenced{false};
+    };
+
+    // One independent cache per shard. Under LRU, get() reorders the list
+    // and needs the shard lock exclusively; under CLOCK, get() only takes
+    // it shared. Striping keeps threads on different shards apart.
+    struct Shard {
+        int capacity;
+        list<CacheEntry> cache; // Stores key-value pairs, most recent first
+        unordered_map<string, list<CacheEntry>::iterator> cacheMap;
+
+        vector<ClockEntry> clockSlots; // Sized to capacity under CLOCK
+        unordered_map<string, uint32_t> clockIndex;
+        uint32_t clockUsed = 0;
+        uint32_t clockHand = 0;
+
+        // TTL entries, earliest deadline on top. An entry goes stale when its
+        // key is overwritten, removed or evicted, and is skipped when popped.
+        priority_queue<pair<uint64_t, string>, vector<pair<uint64_t, string>>, greater<>> deadlines;
+
+        unique_ptr<FrequencySketch> sketch; // Null when admission is off
+        atomic<uint64_t> hits{0}, misses{0}, rejected{0}, expired{0};
+
+        shared_mutex shardMutex;
+
+        Shard(int cap, EvictionPolicy policy, bool admission) : capacity(cap) {
+            if (policy == EvictionPolicy::CLOCK) clockSlots = vector<ClockEntry>(cap);
+            if (admission) sketch = make_unique<FrequencySketch>(cap);
+        }
+
+        void recordAccess(size_t h, bool hit) {
+            (hit ? hits : misses).fetch_add(1, memory_order_relaxed);
+            if (sketch) sketch->increment(h);
+        }
+
+        // TinyLFU: a new key only displaces the victim if it has been seen
+        // more often recently, so one-hit wonders from scans stay out.
+        bool admit(size_t candidate, size_t victim) {
+            if (!sketch || sketch->estimate(candidate) > sketch->estimate(victim)) return true;
+            rejected.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+    };
+
+    EvictionPolicy policy;
+    vector<unique_ptr<Shard>> shards;
+    hash<string> hashFunc;
+
+    // The ring already picked this node from the key hash, so keys here
+    // share its high bits; mix before reducing to a shard index.
+    size_t mixedHash(const string &key) const {
+        return hashFunc(key) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    Shard& shardFor(size_t h) {
+        return *shards[(h >> 32) % shards.size()];
+    }
+
+    string getLRU(Shard &shard, const string &key, size_t h) {
+        unique_lock lock(shard.shardMutex);
+        auto it = shard.cacheMap.find(key);
+        if (it != shard.cacheMap.end() && CoarseClock::expired(it->second->expiresAt)) {
+            shard.cache.erase(it->second); // Already holding the lock exclusively: drop it now
+            shard.cacheMap.erase(it);
+            shard.expired.fetch_add(1, memory_order_relaxed);
+            it = shard.cacheMap.end();
+        }
+        shard.recordAccess(h, it != shard.cacheMap.end());
+        if (it == shard.cacheMap.end()) return "Key Not Found";
+
+        shard.cache.splice(shard.cache.begin(), shard.cache, it->second);
+        return shard.cache.front().value;
+    }
+
+    uint64_t deadlineOf(Shard &shard, const string &key) {
+        if (policy == EvictionPolicy::CLOCK) {
+            auto it = shard.clockIndex.find(key);
+            return it == shard.clockIndex.end() ? 0 : shard.clockSlots[it->second].expiresAt;
+        }
+        auto it = shard.cacheMap.find(key);
+        return it == shard.cacheMap.end() ? 0 : it->second->expiresAt;
+    }
+
+    // Under the exclusive lock
+    void trackDeadline(Shard &shard, const string &key, uint64_t expiresAt) {
+        if (expiresAt == 0) return;
+        shard.deadlines.emplace(expiresAt, key);
+        if (shard.deadlines.size() <= 2 * (size_t)shard.capacity) return;
+
+        // Mostly stale: rebuild from the live entries
+        decltype(shard.deadlines) live;
+        if (policy == EvictionPolicy::CLOCK) {
+            for (uint32_t slot = 0; slot < shard.clockUsed; ++slot) {
+                const ClockEntry &entry = shard.clockSlots[slot];
+                if (entry.expiresAt != 0) live.emplace(entry.expiresAt, entry.key);
+            }
+        } else {
+            for (const CacheEntry &entry : shard.cache) {
+                if (entry.expiresAt != 0) live.emplace(entry.expiresAt, entry.key);
+            }
+        }
+        swap(shard.deadlines, live);
+    }
+
+    // Finds the cached key with the earliest deadline that has passed
+    bool popExpired(Shard &shard, string &key) {
+        uint64_t now = CoarseClock::now();
+        while (!shard.deadlines.empty() && shard.deadlines.top().first <= now) {
+            uint64_t deadline = shard.deadlines.top().first;
+            key = shard.deadlines.top().second;
+            shard.deadlines.pop();
+            if (deadlineOf(shard, key) == deadline) return true;
+        }
+        return false;
+    }
+
+    // ifAbsent: leave an existing entry alone (snapshot warm-up must not
+    // overwrite a value written since the restart)
+    void putLRU(Shard &shard, const string &key, const string &value, size_t h, bool ifAbsent = false,
+                uint64_t expiresAt = 0) {
+        unique_lock lock(shard.shardMutex);
+        if (shard.sketch) shard.sketch->increment(h);
+        auto it = shard.cacheMap.find(key);
+        if (it != shard.cacheMap.end()) {
+            if (ifAbsent && !CoarseClock::expired(it->second->expiresAt)) return;
+            shard.cache.erase(it->second);
+        } else if ((int)shard.cache.size() >= shard.capacity) {
+            string expiredKey;
+            auto victim = prev(shard.cache.end());
+            if (popExpired(shard, expiredKey)) {
+                victim = shard.cacheMap[expiredKey];
+                shard.expired.fetch_add(1, memory_order_relaxed);
+            } else if (!shard.admit(h, mixedHash(victim->key))) {
+                return;
+            }
+            shard.cacheMap.erase(victim->key);
+            shard.cache.erase(victim);
+        }
+        shard.cache.push_front({key, value, expiresAt});
+        shard.cacheMap[key] = shard.cache.begin();
+        trackDeadline(shard, key, expiresAt);
+    }
+
+    string getClock(Shard &shard, const string &key, size_t h) {
+        shared_lock lock(shard.shardMutex);
+        auto it = shard.clockIndex.find(key);
+        // Expired entries stay put (the lock is shared) until the hand reclaims them
+        if (it != shard.clockIndex.end() && CoarseClock::expired(shard.clockSlots[it->second].expiresAt)) {
+            it = shard.clockIndex.end();
+        }
+        shard.recordAccess(h, it != shard.clockIndex.end());
+        if (it == shard.clockIndex.end()) return "Key Not Found";
+
+        ClockEntry &entry = shard.clockSlots[it->second];
+        if (!entry.referenced.load(memory_order_relaxed)) {
+            entry.referenced.store(true, memory_order_relaxed);
+        }
+        return entry.value;
+    }
+
+    void putClock(Shard &shard, const string &key, const string &value, size_t h, bool ifAbsent = false,
+                  uint64_t expiresAt = 0) {
+        unique_lock lock(shard.shardMutex);
+        if (shard.sketch) shard.sketch->increment(h);
+        auto it = shard.clockIndex.find(key);
+        if (it != shard.clockIndex.end()) {
+            ClockEntry &entry = shard.clockSlots[it->second];
+            if (ifAbsent && !CoarseClock::expired(entry.expiresAt)) return;
+            entry.value = value;
+            entry.expiresAt = expiresAt;
+            entry.referenced.store(true, memory_order_relaxed);
+            trackDeadline(shard, key, expiresAt);
+            return;
+        }
+
+        uint32_t slot;
+        string expiredKey;
+        if ((int)shard.clockUsed < shard.capacity) {
+            slot = shard.clockUsed++;
+        } else if (popExpired(shard, expiredKey)) {
+            slot = shard.clockIndex[expiredKey];
+            shard.expired.fetch_add(1, memory_order_relaxed);
+            shard.clockIndex.erase(expiredKey);
+        } else {
+            // Sweep the hand, giving referenced entries a second chance
+            while (shard.clockSlots[shard.clockHand].referenced.exchange(false, memory_order_relaxed)) {
+                shard.clockHand = (shard.clockHand + 1) % shard.capacity;
+            }
+            slot = shard.clockHand;
+            if (!shard.admit(h, mixedHash(shard.clockSlots[slot].key))) return;
+            shard.clockHand = (shard.clockHand + 1) % shard.capacity;
+            shard.clockIndex.erase(shard.clockSlots[slot].key);
+        }
+        ClockEntry &entry = shard.clockSlots[slot];
+        entry.key = key;
+        entry.value = value;
+        entry.expiresAt = expiresAt;
+        entry.referenced.store(false, memory_order_relaxed);
+        shard.clockIndex[key] = slot;
+        trackDeadline(shard, key, expiresAt);
+    }
+
+public:
+    LRUCache(int cap, int shardCount = 1, EvictionPolicy evictionPolicy = EvictionPolicy::LRU,
+             bool admissionFilter = false)
+        : policy(evictionPolicy) {
+        cap = max(1, cap);
+        shardCount = min(max(1, shardCount), cap); // Every shard holds at least one entry
+        // Shards split cap exactly: the first cap % shardCount take one extra
+        for (int i = 0; i < shardCount; ++i) {
+            int perShard = cap / shardCount + (i < cap % shardCount ? 1 : 0);
+            shards.push_back(make_unique<Shard>(perShard, policy, admissionFilter));
+        }
+    }
+
+    string get(const string &key) {
+        size_t h = mixedHash(key);
+        Shard &shard = shardFor(h);
+        if (policy == EvictionPolicy::CLOCK) return getClock(shard, key, h);
+        return getLRU(shard, key, h);
+    }
+
+    void put(const string &key, const string &value) {
+        size_t h = mixedHash(key);
+        Shard &shard = shardFor(h);
+        if (policy == EvictionPolicy::CLOCK) putClock(shard, key, value, h);
+        else putLRU(shard, key, value, h);
+    }
+
+    // Entry reads as a miss once ttl has passed (to within a few ms)
+    void put(const string &key, const string &value, chrono::nanoseconds ttl) {
+        size_t h = mixedHash(key);
+        Shard &shard = shardFor(h);
+        uint64_t expiresAt = CoarseClock::deadlineAfter(ttl);
+        if (policy == EvictionPolicy::CLOCK) putClock(shard, key, value, h, false, expiresAt);
+        else putLRU(shard, key, value, h, false, expiresAt);
+    }
+
+    void putIfAbsent(const string &key, const string &value) {
+        size_t h = mixedHash(key);
+        Shard &shard = shardFor(h);
+        if (policy == EvictionPolicy::CLOCK) putClock(shard, key, value, h, true);
+        else putLRU(shard, key, value, h, true);
+    }
+
+    // fn(key, value) shard by shard, most- to least-recently-used within
+    // each shard (CLOCK: newest slot behind the hand first). Re-inserting
+    // in reverse rebuilds every shard with the same eviction order.
+    // Entries with a TTL are skipped: re-inserted, they would never expire.
+    template <typename Fn>
+    void forEachByRecency(Fn &&fn) {
+        for (auto &shardPtr : shards) {
+            Shard &shard = *shardPtr;
+            shared_lock lock(shard.shardMutex);
+            if (policy == EvictionPolicy::CLOCK) {
+                for (uint32_t i = 1; i <= shard.clockUsed; ++i) {
+                    uint32_t slot = (shard.clockHand + shard.clockUsed - i) % shard.clockUsed;
+                    if (shard.clockSlots[slot].expiresAt == 0) fn(shard.clockSlots[slot].key, shard.clockSlots[slot].value);
+                }
+            } else {
+                for (const CacheEntry &entry : shard.cache) {
+                    if (entry.expiresAt == 0) fn(entry.key, entry.value);
+                }
+            }
+        }
+    }
+
+    CacheStats stats() const {
+        CacheStats total;
+        for (const auto &shard : shards) {
+            total.hits += shard->hits.load(memory_order_relaxed);
+            total.misses += shard->misses.load(memory_order_relaxed);
+            total.rejected += shard->rejected.load(memory_order_relaxed);
+            total.expired += shard->expired.load(memory_order_relaxed);
+        }
+        return total;
+    }
+
+    int shardCount() const { return shards.size(); }
+};
+
+
+/*
+Slab-backed LRU variant: every entry lives in a slab preallocated to
+capacity, the recency list is linked through 32-bit indices, and keys are
+indexed by a linear-probing table of slab indices. Evicted slots are
+reused in place (assign() keeps the string buffers), so once the slab is
+warm, put and eviction never touch the heap.
+*/
+
+class SlabLRUCache {
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        string key;
+        string value;
+        size_t hash = 0;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+    };
+
+    vector<Node> slab;          // Fixed at capacity, never reallocated
+    vector<uint32_t> table;     // Open addressing: bucket -> slab index
+    size_t mask;
+    uint32_t head = NIL, tail = NIL;
+    uint32_t used = 0;
+    hash<string> hashFunc;
+    mutex slabMutex;
+
+    // Returns the bucket holding key, or NIL if absent
+    uint32_t findBucket(const string &key, size_t h) const {
+        for (size_t pos = h & mask;; pos = (pos + 1) & mask) {
+            uint32_t idx = table[pos];
+            if (idx == NIL) return NIL;
+            if (slab[idx].hash == h && slab[idx].key == key) return pos;
+        }
+    }
+
+    void insertBucket(uint32_t idx) {
+        size_t pos = slab[idx].hash & mask;
+        while (table[pos] != NIL) pos = (pos + 1) & mask;
+        table[pos] = idx;
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    void eraseBucket(size_t hole) {
+        table[hole] = NIL;
+        for (size_t j = (hole + 1) & mask; table[j] != NIL; j = (j + 1) & mask) {
+            size_t home = slab[table[j]].hash & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                table[hole] = table[j];
+                table[j] = NIL;
+                hole = j;
+            }
+        }
+    }
+
+    void unlink(uint32_t idx) {
+        Node &n = slab[idx];
+        if (n.prev != NIL) slab[n.prev].next = n.next; else head = n.next;
+        if (n.next != NIL) slab[n.next].prev = n.prev; else tail = n.prev;
+        n.prev = n.next = NIL;
+    }
+
+    void pushFront(uint32_t idx) {
+        Node &n = slab[idx];
+        n.prev = NIL;
+        n.next = head;
+        if (head != NIL) slab[head].prev = idx;
+        head = idx;
+        if (tail == NIL) tail = idx;
+    }
 
 public:
-    LRUCache(int cap) : capacity(cap) {}
+    SlabLRUCache(int cap) : slab(max(1, cap)) {
+        size_t buckets = 1;
+        while (buckets < slab.size() * 2) buckets <<= 1; // Load factor <= 0.5
+        table.assign(buckets, NIL);
+        mask = buckets - 1;
+    }
 
     string get(const string &key) {
-        shared_lock lock(cacheMutex);
-        if (cacheMap.find(key) == cacheMap.end()) return "Key Not Found";
+        lock_guard lock(slabMutex);
+        uint32_t pos = findBucket(key, hashFunc(key));
+        if (pos == NIL) return "Key Not Found";
 
-        cache.splice(cache.begin(), cache, cacheMap[key]);
-        return cache.front().second;
+        uint32_t idx = table[pos];
+        if (idx != head) {
+            unlink(idx);
+            pushFront(idx);
+        }
+        return slab[idx].value;
     }
 
     void put(const string &key, const string &value) {
-        unique_lock lock(cacheMutex);
-        if (cacheMap.find(key) != cacheMap.end()) {
-            cache.erase(cacheMap[key]);
-        } else if (cache.size() >= capacity) {
-            cacheMap.erase(cache.back().first);
-            cache.pop_back();
-        }
-        cache.push_front({key, value});
-        cacheMap[key] = cache.begin();
+        lock_guard lock(slabMutex);
+        size_t h = hashFunc(key);
+        uint32_t pos = findBucket(key, h);
+        if (pos != NIL) {
+            uint32_t idx = table[pos];
+            slab[idx].value.assign(value);
+            if (idx != head) {
+                unlink(idx);
+                pushFront(idx);
+            }
+            return;
+        }
+
+        uint32_t idx;
+        if (used < slab.size()) {
+            idx = used++;
+        } else {
+            idx = tail; // Evict LRU entry and recycle its slot
+            eraseBucket(findBucket(slab[idx].key, slab[idx].hash));
+            unlink(idx);
+        }
+        Node &n = slab[idx];
+        n.key.assign(key);
+        n.value.assign(value);
+        n.hash = h;
+        insertBucket(idx);
+        pushFront(idx);
     }
 };
 
@@ -57,79 +549,247 @@ Now, each node in the consistent hashing ring will have an LRUCache instance.
 
 class ConsistentHashing {
     private:
-        map<int, string> ring; // Virtual node positions mapped to nodes
-        hash<string> hashFunc; // Hash function for keys
-        unordered_map<string, LRUCache> nodeCaches; // LRUCache per node
-        set<string> failedNodes; // Track failed nodes
+        HashRing ring; // Virtual node positions mapped to node ids
+        vector<unique_ptr<LRUCache>> nodeCaches; // LRUCache per node id
+        vector<bool> failedNodes; // Track failed nodes by id
         int lastUsedNode = 0;
+
+        // Snapshot a restarted node serves misses from while its cache refills.
+        // Keys written since the restart are never taken from the snapshot,
+        // even after the cache evicts or refuses the new value.
+        struct Warmup {
+            unique_ptr<Snapshot> snapshot;
+            atomic<bool> loading{true};
+            thread loader;
+            mutex touchedMutex;
+            unordered_set<string> touched; // Written during warm-up
+
+            bool wasTouched(const string& key) {
+                lock_guard lock(touchedMutex);
+                return touched.count(key) > 0;
+            }
+        };
+        vector<unique_ptr<Warmup>> warmups; // By node id, null when not warming
+
+        unique_ptr<LsmStore> storage; // Backing store; null runs the cache alone
+
+        // Storage reads in progress: later misses on the same key wait on
+        // the first caller's result instead of hitting storage again
+        mutex inflightMutex;
+        unordered_map<string, shared_future<string>> inflight;
+        atomic<uint64_t> storageReads{0}, coalescedReads{0};
+        atomic<int64_t> storageLatencyUs{0}; // Simulated per-read storage latency
+
+        // Single-flight miss path. The loaded value goes in with
+        // putIfAbsent so it can't clobber a put that landed meanwhile.
+        string loadThrough(const string& key, uint32_t node, bool available) {
+            unique_lock lock(inflightMutex);
+            auto it = inflight.find(key);
+            if (it != inflight.end()) {
+                shared_future<string> pending = it->second;
+                lock.unlock();
+                coalescedReads.fetch_add(1, memory_order_relaxed);
+                return pending.get();
+            }
+            promise<string> loaded;
+            inflight.emplace(key, loaded.get_future().share());
+            lock.unlock();
+
+            storageReads.fetch_add(1, memory_order_relaxed);
+            string value;
+            exception_ptr failure;
+            try {
+                value = readFromStorage(key);
+                if (value != "Key Not Found" && available) nodeCaches[node]->putIfAbsent(key, value);
+                loaded.set_value(value);
+            } catch (...) {
+                failure = current_exception();
+                loaded.set_exception(failure); // Waiters see the same failure
+            }
+            lock.lock();
+            inflight.erase(key);
+            if (failure) rethrow_exception(failure);
+            return value;
+        }
+
+        bool isAvailable(uint32_t node) const {
+            return node != HashRing::NO_NODE && ring.isLive(node) && !failedNodes[node];
+        }
+
+        void stopWarmup(uint32_t node) {
+            if (node >= warmups.size() || !warmups[node]) return;
+            if (warmups[node]->loader.joinable()) warmups[node]->loader.join();
+            warmups[node].reset();
+        }
     
     public:
-        void addNode(const string& nodeName, int cacheSize) {
-            int hash = hashFunc(nodeName);
-            ring[hash] = nodeName;
-            nodeCaches[nodeName] = LRUCache(cacheSize); // Each node has an LRU cache
+        ConsistentHashing() = default;
+
+        // Read-through / write-through over an LSM store kept in storageDir
+        explicit ConsistentHashing(const string& storageDir) : storage(make_unique<LsmStore>(storageDir)) {}
+
+        // Swap the key -> node routing (ring, jump hash, maglev table)
+        void setRoutingStrategy(unique_ptr<RoutingStrategy> strategy) {
+            ring.setStrategy(move(strategy));
+        }
+
+        // weight scales the node's share of the keyspace, e.g. in proportion to cacheSize
+        void addNode(const string& nodeName, int cacheSize, int shardCount = 1,
+                     EvictionPolicy policy = EvictionPolicy::LRU, bool admissionFilter = false,
+                     int weight = 1) {
+            uint32_t node = ring.addNode(nodeName, weight * HashRing::VIRTUAL_NODES_PER_WEIGHT);
+            if (node >= nodeCaches.size()) {
+                nodeCaches.resize(node + 1);
+                failedNodes.resize(node + 1, false);
+                warmups.resize(node + 1);
+            }
+            failedNodes[node] = false;
+            nodeCaches[node] = make_unique<LRUCache>(cacheSize, shardCount, policy, admissionFilter); // Each node has an LRU cache
+        }
+
+        CacheStats nodeStats(const string& nodeName) const {
+            uint32_t node = ring.indexOf(nodeName);
+            return isAvailable(node) ? nodeCaches[node]->stats() : CacheStats{};
+        }
+
+        // Hot path: compact node id, no string copies
+        uint32_t getNodeId(const string& key) const {
+            return ring.nodeFor(key);
         }
     
         string getNode(const string& key) {
-            int keyHash = hashFunc(key);
-            auto it = ring.lower_bound(keyHash);
-            if (it == ring.end()) return ring.begin()->second;
-            return it->second;
+            uint32_t node = getNodeId(key);
+            return node == HashRing::NO_NODE ? "No Available Nodes" : ring.nodeName(node);
         }
 
 
-        string getBalancedNode() {
-            lastUsedNode = (lastUsedNode + 1) % map.size();
-            return map[lastUsedNode];
+        uint32_t getBalancedNode() {
+            for (size_t tried = 0; tried < ring.nodeCount(); ++tried) {
+                lastUsedNode = (lastUsedNode + 1) % ring.nodeCount();
+                if (isAvailable(lastUsedNode)) return lastUsedNode;
+            }
+            return HashRing::NO_NODE;
         }
 
         void removeNode(const std::string& nodeName) {
-            for (auto it = ring.begin(); it != ring.end(); ) {
-                if (it->second == nodeName) {
-                    it = ring.erase(it);
-                } else {
-                    ++it;
-                }
-            }
-            nodeCaches.erase(nodeName);
-            failedNodes.insert(nodeName);
+            uint32_t node = ring.indexOf(nodeName);
+            if (node == HashRing::NO_NODE) return;
+            ring.removeNode(nodeName);
+            stopWarmup(node);
+            nodeCaches[node].reset();
+            failedNodes[node] = true;
         }
     
         string get(const string& key) {
-            string assignedNode = getNode(key);
-            if (failedNodes.find(assignedNode) == failedNodes.end()) {
-                string value = nodeCaches[assignedNode].get(key);
+            uint32_t assignedNode = getNodeId(key);
+            bool available = isAvailable(assignedNode);
+            if (available) {
+                string value = nodeCaches[assignedNode]->get(key);
                 if (value != "Key Not Found") return value;
+
+                // Not reloaded yet: answer from the mmapped snapshot, unless
+                // the key was written since and storage has the newer value
+                Warmup *warmup = warmups[assignedNode].get();
+                if (warmup && warmup->loading.load(memory_order_acquire) && !warmup->wasTouched(key)) {
+                    if (auto hit = warmup->snapshot->find(key)) return string(*hit);
+                }
             }
-            return "Key Not Found";
-
-                // Cache miss: Fetch from storage
-            string value = readFromStorage(key);
-            if (value != "Persistent_Value") return "Key Not Found";
-            
-            // Store back in cache
-            put(key, value);
-            return value;
+
+            // Cache miss: fetch from storage once and keep it on the owning node
+            return loadThrough(key, assignedNode, available);
         }
         
     
-        void put(const string& key, const string& value) {
-            string assignedNode = getNode(key);
-            if (failedNodes.find(assignedNode) == failedNodes.end()) {
-                nodeCaches[assignedNode].put(key, value);
+        // Write-through: storage first, so a later miss never reads a stale
+        // value. False, with the cache untouched, if storage refused the
+        // write (see storageError()).
+        bool put(const string& key, const string& value) {
+            if (storage && !storage->put(key, value)) return false;
+            uint32_t assignedNode = getNodeId(key);
+            if (isAvailable(assignedNode)) {
+                Warmup *warmup = warmups[assignedNode].get();
+                if (warmup && warmup->loading.load(memory_order_acquire)) {
+                    lock_guard lock(warmup->touchedMutex);
+                    warmup->touched.insert(key);
+                }
+                nodeCaches[assignedNode]->put(key, value);
             } else {
-                string backupNode = getBalancedNode(key);
-                if (backupNode != "No Available Nodes") {
-                    nodeCaches[backupNode].put(key, value);
+                uint32_t backupNode = getBalancedNode();
+                if (backupNode != HashRing::NO_NODE) {
+                    nodeCaches[backupNode]->put(key, value);
                 }
             }
+            return true;
         }
         
 
+        // Dumps a node's cache (with its LRU order) to path
+        bool saveSnapshot(const string& nodeName, const string& path) {
+            uint32_t node = ring.indexOf(nodeName);
+            if (!isAvailable(node)) return false;
+            vector<pair<string, string>> entries;
+            nodeCaches[node]->forEachByRecency([&](const string& key, const string& value) {
+                entries.emplace_back(key, value);
+            });
+            return Snapshot::write(path, move(entries));
+        }
+
+        // After a restart: serve the node's misses from the snapshot at path
+        // right away and refill its cache from it in the background,
+        // oldest entries first. Keys written meanwhile are not overwritten.
+        void warmNode(const string& nodeName, const string& path) {
+            uint32_t node = ring.indexOf(nodeName);
+            if (!isAvailable(node)) return;
+            stopWarmup(node);
+            auto warmup = make_unique<Warmup>();
+            warmup->snapshot = make_unique<Snapshot>(path);
+            Warmup *w = warmup.get();
+            LRUCache *cache = nodeCaches[node].get();
+            w->loader = thread([w, cache] {
+                w->snapshot->forEachOldestFirst([w, cache](string_view key, string_view value) {
+                    string k(key);
+                    lock_guard lock(w->touchedMutex); // A put marks the key before writing it
+                    if (!w->touched.count(k)) cache->putIfAbsent(k, string(value));
+                });
+                w->loading.store(false, memory_order_release);
+            });
+            warmups[node] = move(warmup);
+        }
+
+        bool isWarming(const string& nodeName) const {
+            uint32_t node = ring.indexOf(nodeName);
+            return node != HashRing::NO_NODE && node < warmups.size() && warmups[node] &&
+                   warmups[node]->loading.load(memory_order_acquire);
+        }
+
+        ~ConsistentHashing() {
+            for (uint32_t node = 0; node < warmups.size(); ++node) stopWarmup(node);
+        }
+
         string readFromStorage(const string &key) {
-            cout << "Fetching " << key << " from storage..." << endl;
-            return "Persistent_Value"; // Simulated value
+            if (!storage) return "Key Not Found";
+            if (int64_t us = storageLatencyUs.load(memory_order_relaxed)) this_thread::sleep_for(chrono::microseconds(us));
+            return storage->get(key).value_or("Key Not Found");
+        }
+
+        LsmStats storageStats() const {
+            return storage ? storage->stats() : LsmStats{};
+        }
+
+        // Last storage flush or compaction failure, empty if none
+        string storageError() const {
+            return storage ? storage->lastError() : string();
         }
+
+        // Makes every storage read take at least latency, as a remote store
+        // would; lets a demo overlap concurrent misses on one key
+        void setStorageLatency(chrono::microseconds latency) {
+            storageLatencyUs.store(latency.count(), memory_order_relaxed);
+        }
+
+        // Misses that went to storage vs. ones that waited on another caller's read
+        uint64_t storageReadCount() const { return storageReads.load(memory_order_relaxed); }
+        uint64_t coalescedReadCount() const { return coalescedReads.load(memory_order_relaxed); }
     
     };
     
@@ -162,10 +822,26 @@ class LoadBalancer {
 
 
     int main() {
-        ConsistentHashing ch;
-        ch.addNode("NodeA", 3);
-        ch.addNode("NodeB", 3);
-        ch.addNode("NodeC", 3);
+        filesystem::remove_all("/tmp/lru_cache_storage");
+        ConsistentHashing ch("/tmp/lru_cache_storage");
+
+        // Per-node cache settings, reused when a node is restarted
+        struct NodeConfig {
+            int cacheSize, shardCount;
+            EvictionPolicy policy;
+            bool admissionFilter;
+            int weight;
+        };
+        map<string, NodeConfig> nodeConfigs = {
+            {"NodeA", {3, 1, EvictionPolicy::LRU, false, 1}},
+            {"NodeB", {3, 1, EvictionPolicy::LRU, false, 1}},
+            {"NodeC", {6, 2, EvictionPolicy::CLOCK, false, 2}}, // 2 lock shards, double keyspace share
+        };
+        auto addConfiguredNode = [&](const string& name) {
+            const NodeConfig& c = nodeConfigs.at(name);
+            ch.addNode(name, c.cacheSize, c.shardCount, c.policy, c.admissionFilter, c.weight);
+        };
+        for (const auto& entry : nodeConfigs) addConfiguredNode(entry.first);
     
         LoadBalancer lb(&ch);
     
@@ -177,21 +853,96 @@ class LoadBalancer {
     
         ch.removeNode("NodeA"); // Simulate node failure
         cout << "Get user1 after NodeA failure: " << lb.handleGet("user1") << endl;
+
+        // More keys than the caches hold: evicted ones are read back through storage
+        for (int i = 0; i < 50; ++i) ch.put("bulk" + to_string(i), "v" + to_string(i));
+        cout << "Get bulk0 after eviction: " << ch.get("bulk0") << endl;
+
+        // A burst of concurrent misses on one evicted key: one storage read, the rest wait on it.
+        // The read is slowed down and the readers released together so they really overlap.
+        const int READERS = 8;
+        ch.setStorageLatency(chrono::milliseconds(100));
+        uint64_t readsBefore = ch.storageReadCount(), coalescedBefore = ch.coalescedReadCount();
+        atomic<int> ready{0};
+        atomic<bool> go{false};
+        vector<thread> readers;
+        for (int t = 0; t < READERS; ++t) {
+            readers.emplace_back([&] {
+                ready.fetch_add(1);
+                while (!go.load()) this_thread::yield();
+                ch.get("bulk1");
+            });
+        }
+        while (ready.load() < READERS) this_thread::yield();
+        go.store(true);
+        for (auto &r : readers) r.join();
+        ch.setStorageLatency(chrono::microseconds(0));
+        uint64_t coalesced = ch.coalescedReadCount() - coalescedBefore;
+        cout << READERS << " concurrent misses on bulk1: " << ch.storageReadCount() - readsBefore
+             << " storage read(s), " << coalesced << " coalesced"
+             << (coalesced == READERS - 1 ? " (all but the first)" : " (expected " + to_string(READERS - 1) + ")") << endl;
+
+        SlabLRUCache slabCache(2);
+        slabCache.put("k1", "v1");
+        slabCache.put("k2", "v2");
+        slabCache.get("k1");          // k2 becomes LRU
+        slabCache.put("k3", "v3");    // Reuses k2's slot
+        cout << "Slab get k2: " << slabCache.get("k2") << ", k1: " << slabCache.get("k1") << endl;
+
+        // Hot set of 80 keys interleaved with a one-pass scan twice as long
+        for (bool admission : {false, true}) {
+            LRUCache policyCache(100, 1, EvictionPolicy::LRU, admission);
+            for (int i = 0; i < 20000; ++i) {
+                string hot = "hot" + to_string(i % 80);
+                if (policyCache.get(hot) == "Key Not Found") policyCache.put(hot, "h");
+                for (int j = 0; j < 2; ++j) {
+                    string cold = "scan" + to_string(i * 2 + j);
+                    if (policyCache.get(cold) == "Key Not Found") policyCache.put(cold, "c");
+                }
+            }
+            CacheStats st = policyCache.stats();
+            cout << (admission ? "TinyLFU" : "Plain LRU") << " hit ratio under scan: " << st.hitRatio()
+                 << " (hits " << st.hits << ", misses " << st.misses << ", rejected " << st.rejected << ")" << endl;
+        }
+
+        // Expired sessions are evicted before any live page, whatever their recency
+        for (EvictionPolicy evictionPolicy : {EvictionPolicy::LRU, EvictionPolicy::CLOCK}) {
+            LRUCache ttlCache(100, 1, evictionPolicy);
+            for (int i = 0; i < 50; ++i) ttlCache.put("page" + to_string(i), "p");
+            for (int i = 0; i < 50; ++i) ttlCache.put("session" + to_string(i), "s", chrono::milliseconds(20));
+            this_thread::sleep_for(chrono::milliseconds(40));
+            for (int i = 0; i < 50; ++i) ttlCache.put("new" + to_string(i), "n");
+            int pages = 0;
+            for (int i = 0; i < 50; ++i) pages += ttlCache.get("page" + to_string(i)) != "Key Not Found";
+            cout << (evictionPolicy == EvictionPolicy::LRU ? "LRU" : "CLOCK") << " with TTL: " << pages
+                 << "/50 pages kept, " << ttlCache.stats().expired << " expired sessions evicted" << endl;
+        }
+
+        // Restart user2's node from a snapshot: reads hit while it refills
+        string warmNodeName = ch.getNode("user2");
+        string snapshotPath = "/tmp/" + warmNodeName + ".snap";
+        if (ch.saveSnapshot(warmNodeName, snapshotPath)) {
+            ch.removeNode(warmNodeName);
+            addConfiguredNode(warmNodeName); // Same capacity and shards as when the snapshot was taken
+            ch.warmNode(warmNodeName, snapshotPath);
+            cout << "Get user2 on restarted " << warmNodeName << ": " << ch.get("user2") << endl;
+        }
     
         return 0;
     }
 
 
+/*
 +-------------------------------------------------------------------------+
 |                      LRUCache                                           |
 +-------------------------------------------------------------------------+
-| - capacity: int                                                         |
-| - cache: list<pair<string, string>>                                     |
-| - cacheMap: unordered_map<string, list<pair<string, string>>::iterator> |
-| - cacheMutex: shared_mutex                                              |
+| - shards: vector<unique_ptr<Shard>>                                     |
+| - Shard: {capacity, cache list, cacheMap, shardMutex}                   |
+| - hashFunc: hash<string>                                                |
 +-------------------------------------------------------------------------+
 | + get(key: string) -> string                                            |
 | + put(key: string, value: string)                                       |
+| + put(key: string, value: string, ttl: nanoseconds)                     |
 +-------------------------------------------------------------------------+
         ^                            ^
         |                            |
@@ -201,15 +952,16 @@ class LoadBalancer {
 +-------------------------------------------------+                                                                +-----------------------------------+
 |     ConsistentHashing                           |                                                                |         LoadBalancer             |
 +-------------------------------------------------+                                                                 +-----------------------------------+
-| - ring: map<int, string>                        |                                                                | - ch: ConsistentHashing*         |
-| - hashFunc: hash<string>                        |                                                                +-----------------------------------+
-| - nodeCaches: unordered_map<string, LRUCache>   |                                                                | + handlePut(key, value)          |
-| - failedNodes: set<string>                      |                                                                | + handleGet(key) -> string       |
-| - lastUsedNode: int                             |                                                                +-----------------------------------+
+| - ring: HashRing (sorted vnode array)           |                                                                | - ch: ConsistentHashing*         |
+| - nodeCaches: vector<unique_ptr<LRUCache>>      |                                                                +-----------------------------------+
+| - failedNodes: vector<bool> (by node id)        |                                                                | + handlePut(key, value)          |
+| - lastUsedNode: int                             |                                                                | + handleGet(key) -> string       |
+| - storage: unique_ptr<LsmStore>                 |                                                                +-----------------------------------+
 +-------------------------------------------------+
-| + addNode(nodeName: string, cacheSize: int)     |
+| + addNode(name, cacheSize, shardCount = 1)      |
 | + getNode(key: string) -> string                |    (3)
-| + getBalancedNode() -> string                   |
+| + getNodeId(key: string) -> uint32_t            |
+| + getBalancedNode() -> uint32_t                 |
 | + get(key: string) -> string                    |
 | + put(key: string, value: string)               |
 | + readFromStorage(key: string) -> string        |
@@ -222,14 +974,14 @@ class LoadBalancer {
 +--------------------------------------------------------------------------+
 |                        LRUCache                                          |
 +--------------------------------------------------------------------------+
-| - capacity: int                                                          |
-| - cache: list<pair<string, string>>                                      |
-| - cacheMap: unordered_map<string, list<pair<string, string>>::iterator>  |
-| - cacheMutex: shared_mutex                                               |
+| - shards: vector<unique_ptr<Shard>>                                      |
+| - Shard: {capacity, cache list, cacheMap, shardMutex}                    |
+| - hashFunc: hash<string>                                                 |
 +--------------------------------------------------------------------------+
 | + get(key: string) -> string                                             |
 | + put(key: string, value: string)                                        |
 +--------------------------------------------------------------------------+
+*/
 
 
 /*
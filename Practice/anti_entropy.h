@@ -0,0 +1,160 @@
+#ifndef ANTI_ENTROPY_H
+#define ANTI_ENTROPY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <mutex>
+#include <cstdint>
+#include "stable_hash.h"
+#include "replication.h"
+
+/*
+Hinted handoff: while a replica is down, its copy of a write goes to a
+stand-in node further along the key's preference list, tagged with the
+replica it was meant for. The stand-in keeps these hints apart from its
+own data and hands them back when the replica recovers.
+
+Only the newest version per (replica, key) is kept, so a hot key that is
+rewritten during an outage costs one hint. Past the limit, hints are
+dropped and counted; anti-entropy repairs whatever they would have
+carried.
+*/
+
+class HintLog {
+private:
+    mutable std::mutex mtx;
+    std::unordered_map<uint32_t, std::unordered_map<std::string, std::string>> byReplica; // Encoded VersionedValues
+    size_t count = 0;
+    size_t limit;
+    uint64_t dropped = 0;
+
+public:
+    explicit HintLog(size_t maxHints = 1 << 16) : limit(maxHints) {}
+
+    // Returns false if the hint was dropped because the log is full
+    bool add(uint32_t replica, const std::string& key, const std::string& stored) {
+        std::lock_guard lock(mtx);
+        auto& hints = byReplica[replica];
+        auto it = hints.find(key);
+        if (it != hints.end()) {
+            if (VersionedValue::decode(stored).version > VersionedValue::decode(it->second).version) it->second = stored;
+            return true;
+        }
+        if (count >= limit) {
+            ++dropped;
+            return false;
+        }
+        hints.emplace(key, stored);
+        ++count;
+        return true;
+    }
+
+    std::optional<std::string> find(uint32_t replica, std::string_view key) const {
+        std::lock_guard lock(mtx);
+        auto hints = byReplica.find(replica);
+        if (hints == byReplica.end()) return std::nullopt;
+        auto it = hints->second.find(std::string(key));
+        if (it == hints->second.end()) return std::nullopt;
+        return it->second;
+    }
+
+    // Removes and returns every hint meant for replica
+    std::vector<std::pair<std::string, std::string>> take(uint32_t replica) {
+        std::lock_guard lock(mtx);
+        std::vector<std::pair<std::string, std::string>> out;
+        auto hints = byReplica.find(replica);
+        if (hints == byReplica.end()) return out;
+        out.reserve(hints->second.size());
+        for (auto& entry : hints->second) out.emplace_back(entry.first, std::move(entry.second));
+        count -= out.size();
+        byReplica.erase(hints);
+        return out;
+    }
+
+    void setLimit(size_t maxHints) {
+        std::lock_guard lock(mtx);
+        limit = maxHints;
+    }
+
+    size_t size() const {
+        std::lock_guard lock(mtx);
+        return count;
+    }
+
+    uint64_t droppedCount() const {
+        std::lock_guard lock(mtx);
+        return dropped;
+    }
+};
+
+/*
+Merkle tree over the key-hash space of one replica's data. The space is
+split into LEAVES equal ranges by the top DEPTH bits of the key hash. A
+leaf's digest is the XOR of its entries' hashes, so the tree can be built
+in one unordered pass over the store. Inner nodes hash their children.
+
+Two replicas compare trees top-down and descend only into subtrees whose
+digests differ. They then exchange the entries of the differing leaf
+ranges, not the whole keyspace.
+*/
+
+class MerkleTree {
+public:
+    static constexpr int DEPTH = 10;
+    static constexpr uint32_t LEAVES = 1u << DEPTH;
+
+private:
+    std::vector<uint64_t> digests = std::vector<uint64_t>(2 * LEAVES, 0); // Heap order, root at 1
+
+public:
+    static uint32_t leafOf(uint64_t keyHash) { return (uint32_t)(keyHash >> (64 - DEPTH)); }
+
+    void add(uint64_t keyHash, std::string_view key, std::string_view value) {
+        digests[LEAVES + leafOf(keyHash)] ^= stablehash::hash64(value.data(), value.size(),
+                                                                stablehash::hash64(key.data(), key.size()));
+    }
+
+    // Computes inner digests; call after the last add()
+    void seal() {
+        for (uint32_t i = LEAVES - 1; i >= 1; --i) {
+            uint64_t children[2] = {digests[2 * i], digests[2 * i + 1]};
+            digests[i] = stablehash::hash64(reinterpret_cast<const char*>(children), sizeof(children));
+        }
+    }
+
+    uint64_t root() const { return digests[1]; }
+
+    // Leaf ranges whose contents differ between a and b. compared counts
+    // the tree nodes looked at, i.e. the digests a real exchange would send.
+    static std::vector<uint32_t> diff(const MerkleTree& a, const MerkleTree& b, uint64_t* compared = nullptr) {
+        std::vector<uint32_t> leaves;
+        std::vector<uint32_t> stack = {1};
+        uint64_t visited = 0;
+        while (!stack.empty()) {
+            uint32_t i = stack.back();
+            stack.pop_back();
+            ++visited;
+            if (a.digests[i] == b.digests[i]) continue;
+            if (i >= LEAVES) {
+                leaves.push_back(i - LEAVES);
+            } else {
+                stack.push_back(2 * i + 1);
+                stack.push_back(2 * i);
+            }
+        }
+        if (compared) *compared += visited;
+        return leaves;
+    }
+};
+
+struct RepairStats {
+    uint64_t hintsReplayed = 0;
+    uint64_t rangesCompared = 0;  // Merkle digests compared
+    uint64_t rangesRepaired = 0;  // Leaf ranges that differed
+    uint64_t keysRepaired = 0;    // Entries copied to the stale side
+};
+
+#endif // ANTI_ENTROPY_H
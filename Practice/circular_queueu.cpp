@@ -1,81 +1,65 @@
 #include <iostream>
-#include <vector>
+#include <thread>
+#include "ring_buffer.h"
 
 using namespace std;
 #define SIZE 4
 
-int ar[SIZE];
-int front=-1;
-int rear =-1;
+/*
+Circular queue on the bounded ring buffers from ring_buffer.h. A full
+queue refuses the enqueue instead of overwriting unread data, and both
+variants are safe across threads: SpscRingBuffer for one producer and one
+consumer, MpmcRingBuffer for any number of each.
 
-void enq(int data)
-{
-    if(front == -1)
-    {
-        front =0;
-    }
-    int idx = (rear + 1) % SIZE; // Circular increment
-    ar[idx] = data;
-    rear = idx;
-}
+Throughput numbers: ring_buffer_benchmark.cpp
+*/
 
-int deq()
+int main()
 {
-     if((front == -1 && rear ==-1))  // Check if queue is empty   
-     {
-        cout << "Queue is empty" << endl;
-        return -1;
-     }
-     else{
-        int tmp = ar[front%SIZE];
-        front = (front + 1) % SIZE;
-        return tmp;
-     }
+    SpscRingBuffer<int> queue(SIZE);
 
-}
-
-void display()
-{
-    cout << "Queue: ";
-    for(int i=SIZE-1;i>=front; i--)
+    for (int data = 1; data <= 6; data++)
     {
-        cout << ar[i] << " ";
+        if (queue.tryPush(data))
+            cout << "Enqueued " << data << endl;
+        else
+            cout << "Queue is full, " << data << " not enqueued" << endl;
     }
-    cout << endl;
-}
-
-int main()
-{
-    enq(1);
-    enq(2);
-    enq(3);
-    enq(4);
-    display();
-    enq(5);
-    display();
-    
-    enq(6);
-    display();
-    enq(7);
-    display();
-    enq(8);
-    display();
-    enq(9);
-    display();
-    enq(10);
-    display();
+    cout << "Queue holds " << queue.sizeApprox() << " of " << queue.capacity() << endl;
 
+    int data;
+    for (int i = 0; i < 5; i++)
+    {
+        if (queue.tryPop(data))
+            cout << "Dequeued " << data << endl;
+        else
+            cout << "Queue is empty" << endl;
+    }
 
-    cout << deq() << endl;
-    display();
-    cout << deq() << endl;
-    display();
-    cout << deq() << endl;
-    display();
-    cout << deq() << endl;
-    display();
-    cout << deq() << endl;
-    display();
+    // Two producers and two consumers through a queue much smaller than
+    // the number of items; push/pop wait for room or data
+    MpmcRingBuffer<int> shared(SIZE);
+    const int PER_PRODUCER = 100000;
+    long long sums[2] = {0, 0};
+    thread producers[2], consumers[2];
+    for (int t = 0; t < 2; t++)
+    {
+        producers[t] = thread([&shared, t] {
+            for (int i = 1; i <= PER_PRODUCER; i++)
+                shared.push(t * PER_PRODUCER + i);
+        });
+        consumers[t] = thread([&shared, &sums, t] {
+            for (int i = 0; i < PER_PRODUCER; i++)
+                sums[t] += shared.pop();
+        });
+    }
+    for (int t = 0; t < 2; t++)
+    {
+        producers[t].join();
+        consumers[t].join();
+    }
+    long long n = 2LL * PER_PRODUCER;
+    cout << "MPMC checksum " << (sums[0] + sums[1] == n * (n + 1) / 2 ? "ok" : "MISMATCH") << endl;
 
     return 0;
-}
\ No newline at end of file
+}
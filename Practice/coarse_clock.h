@@ -0,0 +1,67 @@
+#ifndef COARSE_CLOCK_H
+#define COARSE_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+/*
+Process-wide millisecond clock for TTL checks on hot paths. A ticker
+thread stores the steady_clock time into an atomic every RESOLUTION, so a
+reader pays one relaxed load instead of a clock call.
+
+Readings lag real time by up to one RESOLUTION. deadlineAfter() rounds
+up to cover that, so a key never expires early and at most a couple of
+RESOLUTIONs late. Times are milliseconds since the clock started and are
+never 0, so callers can use 0 for "no deadline".
+*/
+
+class CoarseClock {
+public:
+    static constexpr std::chrono::milliseconds RESOLUTION{1};
+
+    static uint64_t now() {
+        return instance().millis.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t deadlineAfter(std::chrono::nanoseconds ttl) {
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(ttl).count();
+        return now() + (ms > 0 ? (uint64_t)ms : 0) + RESOLUTION.count();
+    }
+
+    // False for 0 (no deadline)
+    static bool expired(uint64_t deadline) {
+        return deadline != 0 && deadline <= now();
+    }
+
+private:
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> millis{1};
+    std::atomic<bool> stopping{false};
+    std::thread ticker;
+
+    CoarseClock() {
+        ticker = std::thread([this] {
+            while (!stopping.load(std::memory_order_relaxed)) {
+                std::this_thread::sleep_for(RESOLUTION);
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+                millis.store(1 + (uint64_t)elapsed.count(), std::memory_order_relaxed);
+            }
+        });
+    }
+
+    ~CoarseClock() {
+        stopping.store(true, std::memory_order_relaxed);
+        ticker.join();
+    }
+
+    // Started on first use
+    static CoarseClock& instance() {
+        static CoarseClock clock;
+        return clock;
+    }
+};
+
+#endif // COARSE_CLOCK_H
@@ -0,0 +1,365 @@
+#ifndef CONSISTENT_HASH_RING_H
+#define CONSISTENT_HASH_RING_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <iterator>
+#include <cstdint>
+#include <algorithm>
+#include "stable_hash.h"
+
+/*
+Key routing shared by the key-value and LRU cache examples.
+
+HashRing keeps the node registry (names, weights, which nodes are live)
+and hands key -> node decisions to a pluggable RoutingStrategy, rebuilt
+whenever the live node set changes:
+
+  RingRouter   - consistent hash ring with weighted virtual nodes (default)
+  JumpRouter   - Jump Consistent Hash, O(1) memory, no weights
+  MaglevRouter - Maglev-style precomputed lookup table, O(1) lookups
+
+Node indices are stable for the lifetime of the ring: removing a node
+keeps its slot, and re-adding the same name reuses it. Keys and node
+names are placed with stablehash::hash64 (XXH64), so placement does not
+depend on the standard library the binary was built with.
+*/
+
+class RoutingStrategy {
+public:
+    virtual ~RoutingStrategy() = default;
+
+    // liveNodes are node indices; weights and names are indexed by node index
+    virtual void rebuild(const std::vector<uint32_t>& liveNodes, const std::vector<int>& weights,
+                         const std::vector<std::string>& names) = 0;
+    virtual uint32_t route(uint64_t keyHash) const = 0;
+    virtual std::unique_ptr<RoutingStrategy> clone() const = 0;
+
+    // Up to count distinct nodes for replication. Default: re-route with a
+    // salted hash until enough distinct nodes turn up.
+    virtual int replicas(uint64_t keyHash, uint32_t* out, int count, int liveCount) const {
+        int found = 0;
+        int wanted = std::min(count, liveCount);
+        for (uint64_t salt = 0; found < wanted && salt < 64ULL * count; ++salt) {
+            uint32_t node = route(salt == 0 ? keyHash : mix(keyHash + salt));
+            if (std::find(out, out + found, node) == out + found) out[found++] = node;
+        }
+        return found;
+    }
+
+    // Appends the hash positions where routing can change, for strategies
+    // that send each contiguous hash range to one place (a key goes where
+    // the first position at or after its hash goes, wrapping). Returns
+    // false when keys are scattered over the hash space instead.
+    virtual bool boundaries(std::vector<uint64_t>&) const { return false; }
+
+protected:
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+};
+
+// Every node is placed virtualNodes (= weight) times, at hash("name#i").
+// Points are (hash, node) pairs in one contiguous sorted array and lookups
+// are a branch-free binary search over it.
+class RingRouter : public RoutingStrategy {
+private:
+    struct Point {
+        uint64_t hash;
+        uint32_t node;
+    };
+
+    std::vector<Point> points; // Sorted by hash
+
+    // lower_bound without data-dependent branches; wraps to 0 past the end
+    size_t pointFor(uint64_t keyHash) const {
+        const Point* base = points.data();
+        size_t len = points.size();
+        while (len > 1) {
+            size_t half = len / 2;
+            base += (base[half].hash < keyHash) ? half : 0;
+            len -= half;
+        }
+        size_t idx = (base - points.data()) + (base->hash < keyHash);
+        return idx == points.size() ? 0 : idx;
+    }
+
+public:
+    void rebuild(const std::vector<uint32_t>& liveNodes, const std::vector<int>& weights,
+                 const std::vector<std::string>& names) override {
+        points.clear();
+        for (uint32_t node : liveNodes) {
+            for (int i = 0; i < std::max(1, weights[node]); ++i) {
+                points.push_back({stablehash::hash64(names[node] + "#" + std::to_string(i)), node});
+            }
+        }
+        std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+            return a.hash < b.hash;
+        });
+    }
+
+    uint32_t route(uint64_t keyHash) const override {
+        return points[pointFor(keyHash)].node;
+    }
+
+    // Distinct nodes found walking clockwise from the key's position
+    int replicas(uint64_t keyHash, uint32_t* out, int count, int liveCount) const override {
+        int found = 0;
+        int wanted = std::min(count, liveCount); // Stop once every live node is found
+        size_t start = pointFor(keyHash);
+        for (size_t step = 0; step < points.size() && found < wanted; ++step) {
+            uint32_t node = points[(start + step) % points.size()].node;
+            if (std::find(out, out + found, node) == out + found) out[found++] = node;
+        }
+        return found;
+    }
+
+    bool boundaries(std::vector<uint64_t>& out) const override {
+        for (const Point& p : points) out.push_back(p.hash);
+        return true;
+    }
+
+    std::unique_ptr<RoutingStrategy> clone() const override {
+        return std::make_unique<RingRouter>(*this);
+    }
+};
+
+// Jump Consistent Hash (Lamping & Veach). Buckets are the live nodes in
+// index order, so growing the cluster only moves ~1/n of the keys, but
+// removing a node from the middle shifts every bucket after it. Weights
+// are ignored: meant for fixed-size, uniform clusters.
+class JumpRouter : public RoutingStrategy {
+private:
+    std::vector<uint32_t> buckets;
+
+    static int32_t jump(uint64_t key, int32_t numBuckets) {
+        int64_t b = -1, j = 0;
+        while (j < numBuckets) {
+            b = j;
+            key = key * 2862933555777941757ULL + 1;
+            j = (int64_t)((b + 1) * (double(1LL << 31) / double((key >> 33) + 1)));
+        }
+        return (int32_t)b;
+    }
+
+public:
+    void rebuild(const std::vector<uint32_t>& liveNodes, const std::vector<int>&,
+                 const std::vector<std::string>&) override {
+        buckets = liveNodes;
+    }
+
+    uint32_t route(uint64_t keyHash) const override {
+        return buckets[jump(keyHash, (int32_t)buckets.size())];
+    }
+
+    std::unique_ptr<RoutingStrategy> clone() const override {
+        return std::make_unique<JumpRouter>(*this);
+    }
+};
+
+// Maglev lookup table: each node walks its own permutation of the table
+// slots (offset + j * skip mod M) and claims free slots in turn, taking
+// turns in proportion to its weight. A lookup is one modulo and one load.
+class MaglevRouter : public RoutingStrategy {
+private:
+    static constexpr uint64_t TABLE_SIZE = 65537; // Prime, >> node count
+    std::vector<uint32_t> table;
+
+public:
+    void rebuild(const std::vector<uint32_t>& liveNodes, const std::vector<int>& weights,
+                 const std::vector<std::string>& names) override {
+        table.assign(TABLE_SIZE, UINT32_MAX);
+        if (liveNodes.empty()) return;
+
+        int minWeight = INT32_MAX;
+        for (uint32_t node : liveNodes) minWeight = std::min(minWeight, std::max(1, weights[node]));
+
+        size_t n = liveNodes.size();
+        std::vector<uint64_t> offset(n), skip(n), next(n, 0);
+        std::vector<int> turns(n);
+        for (size_t i = 0; i < n; ++i) {
+            offset[i] = stablehash::hash64(names[liveNodes[i]], 0) % TABLE_SIZE;
+            skip[i] = (stablehash::hash64(names[liveNodes[i]], 1) % (TABLE_SIZE - 1)) + 1;
+            turns[i] = std::max(1, (int)((std::max(1, weights[liveNodes[i]]) + minWeight / 2) / minWeight));
+        }
+
+        uint64_t filled = 0;
+        while (filled < TABLE_SIZE) {
+            for (size_t i = 0; i < n && filled < TABLE_SIZE; ++i) {
+                for (int t = 0; t < turns[i] && filled < TABLE_SIZE; ++t) {
+                    uint64_t slot = (offset[i] + next[i] * skip[i]) % TABLE_SIZE;
+                    while (table[slot] != UINT32_MAX) {
+                        ++next[i];
+                        slot = (offset[i] + next[i] * skip[i]) % TABLE_SIZE;
+                    }
+                    table[slot] = liveNodes[i];
+                    ++next[i];
+                    ++filled;
+                }
+            }
+        }
+    }
+
+    uint32_t route(uint64_t keyHash) const override {
+        return table[keyHash % TABLE_SIZE];
+    }
+
+    std::unique_ptr<RoutingStrategy> clone() const override {
+        return std::make_unique<MaglevRouter>(*this);
+    }
+};
+
+// Keys whose hash is in [first, last]
+struct HashRange {
+    uint64_t first;
+    uint64_t last;
+};
+
+class HashRing {
+private:
+    std::vector<std::string> nodeNames; // Indexed by node index
+    std::vector<int> weights;           // Virtual nodes per node
+    std::vector<bool> live;
+    std::vector<uint32_t> liveNodes;
+    std::unique_ptr<RoutingStrategy> strategy;
+
+    void rebuild() {
+        liveNodes.clear();
+        for (uint32_t node = 0; node < live.size(); ++node) {
+            if (live[node]) liveNodes.push_back(node);
+        }
+        strategy->rebuild(liveNodes, weights, nodeNames);
+    }
+
+public:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+    static constexpr int VIRTUAL_NODES_PER_WEIGHT = 100; // Ring points per unit of node weight
+
+    HashRing() : strategy(std::make_unique<RingRouter>()) {}
+
+    // Snapshot of the topology and routing table, e.g. to keep routing by
+    // the old layout while data moves to the new one
+    HashRing(const HashRing& other)
+        : nodeNames(other.nodeNames), weights(other.weights), live(other.live),
+          liveNodes(other.liveNodes), strategy(other.strategy->clone()) {}
+    HashRing& operator=(const HashRing&) = delete;
+
+    void setStrategy(std::unique_ptr<RoutingStrategy> newStrategy) {
+        strategy = std::move(newStrategy);
+        rebuild();
+    }
+
+    uint64_t hashKey(std::string_view key) const {
+        return stablehash::hash64(key.data(), key.size());
+    }
+
+    // virtualNodes is the node's ring points; weight w is w * VIRTUAL_NODES_PER_WEIGHT
+    uint32_t addNode(const std::string& nodeName, int virtualNodes = VIRTUAL_NODES_PER_WEIGHT) {
+        uint32_t node = indexOf(nodeName);
+        if (node == NO_NODE) {
+            node = nodeNames.size();
+            nodeNames.push_back(nodeName);
+            weights.push_back(virtualNodes);
+            live.push_back(false);
+        }
+        if (live[node]) return node;
+        live[node] = true;
+        weights[node] = virtualNodes;
+        rebuild();
+        return node;
+    }
+
+    void removeNode(const std::string& nodeName) {
+        uint32_t node = indexOf(nodeName);
+        if (node == NO_NODE || !live[node]) return;
+        live[node] = false;
+        rebuild();
+    }
+
+    uint32_t nodeFor(std::string_view key) const {
+        if (liveNodes.empty()) return NO_NODE;
+        return strategy->route(hashKey(key));
+    }
+
+    // Bulk routing: out[i] = nodeFor(keys[i]), hashing the keys in lanes
+    void nodesFor(const std::string* keys, size_t count, uint32_t* out) const {
+        if (liveNodes.empty()) {
+            std::fill(out, out + count, NO_NODE);
+            return;
+        }
+        uint64_t hashes[256];
+        for (size_t i = 0; i < count; i += 256) {
+            size_t n = std::min<size_t>(256, count - i);
+            stablehash::hashBatch(keys + i, n, hashes);
+            for (size_t j = 0; j < n; ++j) out[i + j] = strategy->route(hashes[j]);
+        }
+    }
+
+    // Fills out[] with up to count distinct live nodes for the key, primary
+    // first; returns how many were written.
+    int replicasFor(std::string_view key, uint32_t* out, int count) const {
+        return replicasForHash(hashKey(key), out, count);
+    }
+
+    // Same as replicasFor() for a key already hashed with hashKey()/hashBatch()
+    int replicasForHash(uint64_t keyHash, uint32_t* out, int count) const {
+        if (liveNodes.empty()) return 0;
+        return strategy->replicas(keyHash, out, count, (int)liveNodes.size());
+    }
+
+    // Ranges of the hash space where changed(hash) holds, comparing two
+    // layouts of the same keyspace (e.g. replica sets before and after a
+    // topology change). Between adjacent positions of the two rings
+    // combined both route every hash alike, so changed() is asked once per
+    // such segment. Ranges come back sorted, adjacent ones merged. nullopt
+    // if either strategy does not route by range (jump hash, maglev).
+    template <typename Changed>
+    static std::optional<std::vector<HashRange>> movedRanges(const HashRing& before, const HashRing& after,
+                                                             Changed&& changed) {
+        std::vector<uint64_t> cuts;
+        if (!before.strategy->boundaries(cuts) || !after.strategy->boundaries(cuts)) return std::nullopt;
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+        std::vector<HashRange> ranges;
+        auto add = [&](uint64_t first, uint64_t last) {
+            if (!ranges.empty() && ranges.back().last + 1 == first) ranges.back().last = last;
+            else ranges.push_back({first, last});
+        };
+        if (cuts.empty()) return ranges;
+        bool wrapped = changed(cuts[0]); // (cuts.back(), max] wraps round to [0, cuts[0]]
+        if (wrapped) add(0, cuts[0]);
+        for (size_t i = 1; i < cuts.size(); ++i) {
+            if (changed(cuts[i])) add(cuts[i - 1] + 1, cuts[i]);
+        }
+        if (wrapped && cuts.back() != UINT64_MAX) add(cuts.back() + 1, UINT64_MAX);
+        return ranges;
+    }
+
+    // ranges as returned by movedRanges()
+    static bool inRanges(const std::vector<HashRange>& ranges, uint64_t keyHash) {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), keyHash,
+                                   [](uint64_t hash, const HashRange& range) { return hash < range.first; });
+        return it != ranges.begin() && keyHash <= std::prev(it)->last;
+    }
+
+    uint32_t indexOf(const std::string& nodeName) const {
+        auto it = std::find(nodeNames.begin(), nodeNames.end(), nodeName);
+        return it == nodeNames.end() ? NO_NODE : (uint32_t)(it - nodeNames.begin());
+    }
+
+    const std::string& nodeName(uint32_t node) const { return nodeNames[node]; }
+    bool isLive(uint32_t node) const { return node < live.size() && live[node]; }
+    size_t nodeCount() const { return nodeNames.size(); }
+    bool empty() const { return liveNodes.empty(); }
+};
+
+#endif // CONSISTENT_HASH_RING_H
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include "consistent_hash_ring.h"
+
+/*
+Compares the routing strategies in consistent_hash_ring.h:
+  - balance:   max / mean keys per node, and coefficient of variation
+  - remap:     fraction of keys that change owner when a node joins / leaves
+  - lookups/s: single-threaded nodeFor() throughput
+  - batch/s:   the same keys routed with nodesFor() (lane-batched hashing)
+
+Build: g++ -std=c++17 -O2 consistent_hashing_benchmark.cpp -o consistent_hashing_benchmark
+*/
+
+using namespace std;
+using namespace std::chrono;
+
+const int NODE_COUNT = 10;
+const int KEY_COUNT = 200000;
+const int VIRTUAL_NODES = 100;
+
+struct StrategyCase {
+    string name;
+    function<unique_ptr<RoutingStrategy>()> make;
+};
+
+vector<uint32_t> routeAll(const HashRing& ring, const vector<string>& keys) {
+    vector<uint32_t> owners(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) owners[i] = ring.nodeFor(keys[i]);
+    return owners;
+}
+
+double remapFraction(const vector<uint32_t>& before, const vector<uint32_t>& after) {
+    size_t moved = 0;
+    for (size_t i = 0; i < before.size(); ++i) moved += before[i] != after[i];
+    return (double)moved / before.size();
+}
+
+void runCase(const StrategyCase& sc, const vector<string>& keys) {
+    HashRing ring;
+    ring.setStrategy(sc.make());
+    for (int i = 0; i < NODE_COUNT; ++i) ring.addNode("Node" + to_string(i), VIRTUAL_NODES);
+
+    vector<uint32_t> base = routeAll(ring, keys);
+    vector<size_t> load(NODE_COUNT, 0);
+    for (uint32_t owner : base) load[owner]++;
+    double mean = (double)keys.size() / NODE_COUNT, var = 0, mx = 0;
+    for (size_t l : load) {
+        var += (l - mean) * (l - mean);
+        mx = max(mx, (double)l);
+    }
+    double cv = sqrt(var / NODE_COUNT) / mean;
+
+    ring.addNode("Node" + to_string(NODE_COUNT), VIRTUAL_NODES);
+    double addRemap = remapFraction(base, routeAll(ring, keys));
+    ring.removeNode("Node" + to_string(NODE_COUNT));
+    ring.removeNode("Node" + to_string(NODE_COUNT / 2));
+    double removeRemap = remapFraction(base, routeAll(ring, keys));
+    ring.addNode("Node" + to_string(NODE_COUNT / 2), VIRTUAL_NODES);
+
+    const int rounds = 20;
+    uint64_t checksum = 0;
+    auto start = steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const string& key : keys) checksum += ring.nodeFor(key);
+    }
+    double secs = duration<double>(steady_clock::now() - start).count();
+
+    vector<uint32_t> owners(keys.size());
+    start = steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        ring.nodesFor(keys.data(), keys.size(), owners.data());
+        checksum += owners[r];
+    }
+    double batchSecs = duration<double>(steady_clock::now() - start).count();
+
+    cout << left << setw(8) << sc.name << right << fixed
+         << setw(10) << setprecision(3) << mx / mean
+         << setw(10) << setprecision(4) << cv
+         << setw(12) << setprecision(4) << addRemap
+         << setw(12) << setprecision(4) << removeRemap
+         << setw(14) << setprecision(0) << (rounds * keys.size()) / secs
+         << setw(14) << setprecision(0) << (rounds * keys.size()) / batchSecs
+         << "   (checksum " << checksum % 1000 << ")" << endl;
+}
+
+int main() {
+    vector<string> keys;
+    for (int i = 0; i < KEY_COUNT; ++i) keys.push_back("user" + to_string(i));
+
+    vector<StrategyCase> cases = {
+        {"ring", [] { return make_unique<RingRouter>(); }},
+        {"jump", [] { return make_unique<JumpRouter>(); }},
+        {"maglev", [] { return make_unique<MaglevRouter>(); }},
+    };
+
+    cout << NODE_COUNT << " nodes, " << KEY_COUNT << " keys, " << VIRTUAL_NODES << " vnodes/node (ring)\n"
+         << "Ideal remap on add: " << setprecision(4) << 1.0 / (NODE_COUNT + 1)
+         << ", on remove: " << 1.0 / NODE_COUNT << "\n\n";
+    cout << left << setw(8) << "router" << right << setw(10) << "max/mean" << setw(10) << "cv"
+         << setw(12) << "remap add" << setw(12) << "remap rm" << setw(14) << "lookups/s" << setw(14) << "batch/s" << endl;
+    for (const auto& sc : cases) runCase(sc, keys);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#ifndef DEADLINE_HISTOGRAM_H
+#define DEADLINE_HISTOGRAM_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Counts of pending deadlines by time slot, kept up to date as deadlines are
+added and removed, so "how many are due in [from, to)" needs no scan.
+
+Slots from the current slot to HORIZON later sit in a ring with a Fenwick
+tree over it:
+  - add / remove: O(log SLOTS)
+  - count over a range inside the horizon: O(log SLOTS)
+
+Later deadlines wait in an ordered map of per-slot counts. advance() moves
+each one into the ring once it comes within the horizon. A count over
+slots past the horizon costs one step per occupied slot there.
+
+advance() folds slots that have fallen behind the current slot into a
+single past-due count. Removing a past-due deadline decrements it, so
+pastDue() is the number of deadlines that have passed but are still held.
+*/
+
+class DeadlineHistogram {
+public:
+    static constexpr int SLOT_BITS = 14;
+    static constexpr uint64_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint64_t HORIZON = SLOTS;
+
+private:
+    std::vector<uint64_t> tree = std::vector<uint64_t>(SLOTS + 1, 0); // Fenwick tree over ring positions, 1-based
+    std::vector<uint64_t> slotCounts = std::vector<uint64_t>(SLOTS, 0);
+    std::map<uint64_t, uint64_t> far; // Slots at or past base + HORIZON
+    uint64_t base;                    // Current slot; the ring holds [base, base + HORIZON)
+    uint64_t ringTotal = 0;
+    uint64_t pastDueCount = 0;
+    uint64_t total = 0;
+
+    // Counts wrap on removal (unsigned), which the prefix sums tolerate
+    void ringAdd(uint64_t slot, uint64_t delta) {
+        uint64_t pos = slot & (SLOTS - 1);
+        slotCounts[pos] += delta;
+        ringTotal += delta;
+        for (uint64_t i = pos + 1; i <= SLOTS; i += i & (~i + 1)) tree[i] += delta;
+    }
+
+    // Sum over ring positions [0, pos)
+    uint64_t prefix(uint64_t pos) const {
+        uint64_t sum = 0;
+        for (uint64_t i = pos; i > 0; i -= i & (~i + 1)) sum += tree[i];
+        return sum;
+    }
+
+    // Sum over slots [from, to) with base <= from < to <= base + HORIZON
+    uint64_t ringCount(uint64_t from, uint64_t to) const {
+        if (to - from == SLOTS) return ringTotal;
+        uint64_t a = from & (SLOTS - 1), b = to & (SLOTS - 1);
+        return a < b ? prefix(b) - prefix(a) : ringTotal - (prefix(a) - prefix(b));
+    }
+
+    // Moves far slots that are now within the horizon into the ring
+    void pullFar() {
+        while (!far.empty() && far.begin()->first < base + HORIZON) {
+            if (far.begin()->first < base) pastDueCount += far.begin()->second;
+            else ringAdd(far.begin()->first, far.begin()->second);
+            far.erase(far.begin());
+        }
+    }
+
+public:
+    explicit DeadlineHistogram(uint64_t startSlot = 0) : base(startSlot) {}
+
+    void add(uint64_t slot) {
+        ++total;
+        if (slot < base) ++pastDueCount;
+        else if (slot < base + HORIZON) ringAdd(slot, 1);
+        else ++far[slot];
+    }
+
+    // slot must be one passed to add() and not yet removed
+    void remove(uint64_t slot) {
+        --total;
+        if (slot < base) {
+            --pastDueCount;
+        } else if (slot < base + HORIZON) {
+            ringAdd(slot, (uint64_t)-1);
+        } else {
+            auto it = far.find(slot);
+            if (--it->second == 0) far.erase(it);
+        }
+    }
+
+    // Makes now the current slot; earlier slots become past due
+    void advance(uint64_t now) {
+        if (now <= base) return;
+        if (now - base >= HORIZON) {
+            pastDueCount += ringTotal;
+            std::fill(tree.begin(), tree.end(), 0);
+            std::fill(slotCounts.begin(), slotCounts.end(), 0);
+            ringTotal = 0;
+            base = now;
+            pullFar();
+            return;
+        }
+        for (; base < now; ++base) {
+            uint64_t count = slotCounts[base & (SLOTS - 1)];
+            if (count != 0) {
+                ringAdd(base, (uint64_t)0 - count);
+                pastDueCount += count;
+            }
+        }
+        pullFar();
+    }
+
+    // Deadlines in slots [from, to); slots before the current one count
+    // only as pastDue()
+    uint64_t count(uint64_t from, uint64_t to) const {
+        from = std::max(from, base);
+        if (to <= from) return 0;
+        uint64_t ringEnd = base + HORIZON, sum = 0;
+        if (from < ringEnd) sum += ringCount(from, std::min(to, ringEnd));
+        for (auto it = far.lower_bound(std::max(from, ringEnd)); it != far.end() && it->first < to; ++it) {
+            sum += it->second;
+        }
+        return sum;
+    }
+
+    uint64_t pastDue() const { return pastDueCount; }
+    uint64_t current() const { return base; }
+    size_t size() const { return total; }
+};
+
+#endif // DEADLINE_HISTOGRAM_H
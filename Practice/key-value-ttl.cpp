@@ -1,113 +1,463 @@
 #include <iostream>
-#include <map>
+#include <unordered_map>
+#include <string>
+#include <optional>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "timing_wheel.h"
+#include "deadline_histogram.h"
 
 using namespace std;
 using namespace std::chrono;
 
-map<int, pair<string, long long>> mymap;
-map<long long, int> umap;
+enum class ExpiryPolicy
+{
+    TIMING_WHEEL, // Every TTL key gets a timer; keys are dropped on the tick they expire
+    SAMPLED       // Redis-style: lazy drop on access plus periodic random sampling
+};
 
-int get_avg()
+struct ExpiryStats
 {
-    int cnt = 0;
-    vector<long long> vt;
-    for (auto data : umap)
+    uint64_t expired = 0;          // Keys dropped for their TTL, by any path
+    uint64_t lazyExpired = 0;      // ... found expired by get()
+    uint64_t sampled = 0;          // TTL keys checked by active expire cycles
+    uint64_t cycles = 0;
+    uint64_t cyclesOverBudget = 0; // Cycles stopped by the time budget with dead keys left
+    int budgetPercent = 0;         // Current cycle budget, % of CYCLE_INTERVAL
+};
+
+/*
+Key-value store with per-key TTL. Either policy drops an expired key as
+soon as get() touches it; they differ in how keys nobody reads are found.
+
+TIMING_WHEEL: deadlines are timers on a hierarchical timing wheel
+(timing_wheel.h) ticking every `tick`; a background reaper advances the
+wheel and erases keys as their timers fire.
+  - put with a TTL / overwrite / remove: O(1), the old timer is cancelled
+  - expiry: amortized O(1) per key, paid only when the key expires
+
+SAMPLED: TTL keys are kept in a dense array so they can be sampled at
+random. Every CYCLE_INTERVAL the reaper checks SAMPLE_SIZE random TTL
+keys and drops the expired ones, and repeats while more than a quarter of
+a sample was expired. A cycle also stops when it uses up its time budget,
+a share of CYCLE_INTERVAL. A cycle that runs out of budget doubles the
+share for the next one, up to MAX_BUDGET_PERCENT. Quiet cycles let it
+decay back to MIN_BUDGET_PERCENT. There is no per-key timer memory and no
+per-tick wakeup.
+
+The stop test uses the whole cycle's counts, not one noisy round of
+SAMPLE_SIZE. The reaper spends at most MAX_BUDGET_PERCENT of one core.
+While keys expire well within what that can drop, dead keys stay near a
+quarter of the TTL keys. Past that rate the dead share grows, and the
+backlog drains at the budget's pace without ever scanning every key. In
+the demo a million keys expire within 400 ms, so most of them are still
+held a second later; get() never returns one of them.
+
+Deadlines use steady_clock, so wall-clock adjustments don't expire keys
+early or late.
+
+Every TTL key's deadline is also counted in a DeadlineHistogram of
+STATS_RESOLUTION slots, updated as deadlines are set, cleared or expire.
+So liveKeys(), expiringWithin() and expiryHistogram() cost O(log n) per
+figure under the lock and never copy or walk the keys; writers wait no
+longer than they would for a get(). The figures are exact to one
+STATS_RESOLUTION: a key that expired within the current slot still
+counts as live.
+*/
+class TtlStore
+{
+public:
+    static constexpr milliseconds CYCLE_INTERVAL{100};
+    static constexpr int SAMPLE_SIZE = 20;
+    static constexpr int MIN_BUDGET_PERCENT = 5;
+    static constexpr int MAX_BUDGET_PERCENT = 50;
+    static constexpr milliseconds STATS_RESOLUTION{10};
+
+private:
+    using Wheel = TimingWheel<int>;
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Entry
+    {
+        string value;
+        steady_clock::time_point expiresAt = steady_clock::time_point::max(); // max() without a TTL
+        Wheel::Handle timer = Wheel::NO_HANDLE; // TIMING_WHEEL
+        uint32_t sampleSlot = NO_SLOT;          // SAMPLED: index in ttlKeys
+    };
+
+    const ExpiryPolicy policy;
+    const nanoseconds tick;
+    const steady_clock::time_point epoch = steady_clock::now();
+    mutable mutex mtx;
+    condition_variable reaperCv;
+    unordered_map<int, Entry> entries;
+    Wheel wheel;
+    vector<int> ttlKeys; // SAMPLED: every key with a TTL, for random sampling
+    DeadlineHistogram deadlines; // Every TTL key's deadline, by STATS_RESOLUTION slot
+    mt19937 rng{random_device{}()};
+    ExpiryStats stats;
+    nanoseconds nextCycle = CYCLE_INTERVAL; // SAMPLED: wait before the next cycle
+    bool stopping = false;
+    thread reaper;
+
+    // Rounded up, so a timer never fires before its deadline
+    uint64_t deadlineTick(steady_clock::time_point deadline) const
     {
-        vt.push_back(data.first);
+        return deadline <= epoch ? 0 : (uint64_t)((deadline - epoch + tick - nanoseconds(1)) / tick);
     }
- cout << "----- displaying vector ---- " << endl;
-    for (auto data : vt)
+
+    uint64_t currentTick() const
     {
-        cout << data << endl;
+        return (uint64_t)((steady_clock::now() - epoch) / tick);
     }
 
-    auto now = system_clock::now();
-    long long nanos = duration_cast<nanoseconds>(
-                          now.time_since_epoch())
-                          .count();
+    uint64_t statsSlot(steady_clock::time_point t) const
+    {
+        return t <= epoch ? 0 : (uint64_t)((t - epoch) / STATS_RESOLUTION);
+    }
 
-    cout << "inside avg : nano : " << nanos <<endl;
-    auto it = lower_bound(vt.begin(), vt.end(), nanos);
-    cout << "out :" << *it << endl;
+    bool hasTtlKeys() const
+    {
+        return policy == ExpiryPolicy::TIMING_WHEEL ? wheel.size() > 0 : !ttlKeys.empty();
+    }
 
-    cout << "----- displaying vector after lower bound ---- " << endl;
-    for (; it != vt.end(); ++it)
+    void setDeadline(int key, Entry &entry, steady_clock::time_point expiresAt)
     {
-        cout << *it << endl;
-        cout << mymap[umap[*it]].first << " -> " << mymap[umap[*it]].second << "\n";
-        cnt++;
+        if (entry.expiresAt != steady_clock::time_point::max())
+            deadlines.remove(statsSlot(entry.expiresAt));
+        deadlines.add(statsSlot(expiresAt));
+        entry.expiresAt = expiresAt;
+        if (policy == ExpiryPolicy::TIMING_WHEEL)
+        {
+            if (entry.timer != Wheel::NO_HANDLE)
+                wheel.cancel(entry.timer);
+            entry.timer = wheel.schedule(deadlineTick(expiresAt), key);
+        }
+        else if (entry.sampleSlot == NO_SLOT)
+        {
+            entry.sampleSlot = (uint32_t)ttlKeys.size();
+            ttlKeys.push_back(key);
+        }
+    }
+
+    void clearDeadline(Entry &entry)
+    {
+        if (entry.expiresAt != steady_clock::time_point::max())
+            deadlines.remove(statsSlot(entry.expiresAt));
+        entry.expiresAt = steady_clock::time_point::max();
+        if (entry.timer != Wheel::NO_HANDLE)
+        {
+            wheel.cancel(entry.timer);
+            entry.timer = Wheel::NO_HANDLE;
+        }
+        if (entry.sampleSlot != NO_SLOT)
+        {
+            int moved = ttlKeys.back(); // Swap-remove keeps ttlKeys dense
+            ttlKeys[entry.sampleSlot] = moved;
+            entries.find(moved)->second.sampleSlot = entry.sampleSlot;
+            ttlKeys.pop_back();
+            entry.sampleSlot = NO_SLOT;
+        }
     }
-    return cnt;
-}
+
+    void expire(unordered_map<int, Entry>::iterator it)
+    {
+        clearDeadline(it->second);
+        entries.erase(it);
+        ++stats.expired;
+    }
+
+    // One active expire cycle: sample rounds until few sampled keys were
+    // dead or the budget is spent. Drops the lock and yields between
+    // rounds, so waiting callers get in every SAMPLE_SIZE checks.
+    void sampleCycle(unique_lock<mutex> &lock)
+    {
+        auto start = steady_clock::now();
+        nanoseconds budget = duration_cast<nanoseconds>(CYCLE_INTERVAL) * stats.budgetPercent / 100;
+        bool overBudget = false;
+        uint64_t sampled = 0, dead = 0; // Over the whole cycle: one round of SAMPLE_SIZE is too noisy to stop on
+        ++stats.cycles;
+        while (!stopping && !ttlKeys.empty())
+        {
+            auto now = steady_clock::now();
+            for (int round = 0; round < SAMPLE_SIZE && !ttlKeys.empty(); ++round, ++sampled)
+            {
+                auto it = entries.find(ttlKeys[rng() % ttlKeys.size()]);
+                if (it->second.expiresAt <= now)
+                {
+                    expire(it);
+                    ++dead;
+                }
+            }
+            if (dead * 4 <= sampled)
+                break;
+            if (now - start >= budget)
+            {
+                overBudget = true;
+                break;
+            }
+            lock.unlock();
+            this_thread::yield(); // Relocking at once would usually win the mutex back before a woken caller runs
+            lock.lock();
+        }
+
+        stats.sampled += sampled;
+        if (overBudget)
+        {
+            ++stats.cyclesOverBudget;
+            stats.budgetPercent = min(MAX_BUDGET_PERCENT, stats.budgetPercent * 2);
+        }
+        else
+        {
+            stats.budgetPercent = max(MIN_BUDGET_PERCENT, stats.budgetPercent * 3 / 4);
+        }
+        nextCycle = max(nanoseconds(0), CYCLE_INTERVAL - (steady_clock::now() - start)); // Cycles start CYCLE_INTERVAL apart
+    }
+
+    void reap()
+    {
+        unique_lock<mutex> lock(mtx);
+        while (true)
+        {
+            if (!hasTtlKeys())
+                reaperCv.wait(lock, [this] { return stopping || hasTtlKeys(); });
+            else
+                reaperCv.wait_for(lock, policy == ExpiryPolicy::TIMING_WHEEL ? tick : nextCycle,
+                                  [this] { return stopping; });
+            if (stopping)
+                return;
+            if (policy == ExpiryPolicy::SAMPLED)
+            {
+                sampleCycle(lock);
+                deadlines.advance(statsSlot(steady_clock::now()));
+                continue;
+            }
+            stats.expired += wheel.advance(currentTick(), [this](int key) {
+                auto it = entries.find(key);
+                it->second.timer = Wheel::NO_HANDLE; // Already fired
+                deadlines.remove(statsSlot(it->second.expiresAt));
+                entries.erase(it);
+            });
+            deadlines.advance(statsSlot(steady_clock::now()));
+        }
+    }
+
+    Entry &entryFor(int key)
+    {
+        return entries.try_emplace(key).first->second;
+    }
+
+public:
+    // tickLength is the TIMING_WHEEL resolution; SAMPLED runs every CYCLE_INTERVAL
+    explicit TtlStore(ExpiryPolicy expiryPolicy = ExpiryPolicy::TIMING_WHEEL,
+                      nanoseconds tickLength = milliseconds(1))
+        : policy(expiryPolicy), tick(tickLength), wheel(0)
+    {
+        stats.budgetPercent = 25;
+        reaper = thread(&TtlStore::reap, this);
+    }
+
+    TtlStore(const TtlStore &) = delete;
+    TtlStore &operator=(const TtlStore &) = delete;
+
+    ~TtlStore()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        reaperCv.notify_one();
+        reaper.join();
+    }
+
+    // Stores value until ttl from now; replaces any earlier TTL for key
+    void put(int key, const string &value, nanoseconds ttl)
+    {
+        steady_clock::time_point expiresAt = steady_clock::now() + ttl;
+        bool wasIdle;
+        {
+            lock_guard<mutex> lock(mtx);
+            wasIdle = !hasTtlKeys();
+            Entry &entry = entryFor(key);
+            entry.value = value;
+            setDeadline(key, entry, expiresAt);
+        }
+        if (wasIdle)
+            reaperCv.notify_one();
+    }
+
+    // Stores value with no expiry; clears any earlier TTL for key
+    void put(int key, const string &value)
+    {
+        lock_guard<mutex> lock(mtx);
+        Entry &entry = entryFor(key);
+        clearDeadline(entry);
+        entry.value = value;
+    }
+
+    // An expired key is dropped here rather than waiting for the reaper
+    optional<string> get(int key)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return nullopt;
+        if (it->second.expiresAt <= steady_clock::now())
+        {
+            expire(it);
+            ++stats.lazyExpired;
+            return nullopt;
+        }
+        return it->second.value;
+    }
+
+    bool remove(int key)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return false;
+        clearDeadline(it->second);
+        entries.erase(it);
+        return true;
+    }
+
+    // Keys held, including expired ones not yet dropped (at most a tick's
+    // worth under TIMING_WHEEL; under SAMPLED, about a quarter of the TTL
+    // keys while the reaper keeps up, more while it works off a backlog)
+    size_t size() const
+    {
+        lock_guard<mutex> lock(mtx);
+        return entries.size();
+    }
+
+    uint64_t expired() const
+    {
+        lock_guard<mutex> lock(mtx);
+        return stats.expired;
+    }
+
+    ExpiryStats expiryStats() const
+    {
+        lock_guard<mutex> lock(mtx);
+        return stats;
+    }
+
+    // Keys with a TTL still held
+    size_t pendingTimers() const
+    {
+        lock_guard<mutex> lock(mtx);
+        return policy == ExpiryPolicy::TIMING_WHEEL ? wheel.size() : ttlKeys.size();
+    }
+
+    // Keys held and not yet expired
+    size_t liveKeys()
+    {
+        lock_guard<mutex> lock(mtx);
+        deadlines.advance(statsSlot(steady_clock::now()));
+        return entries.size() - deadlines.pastDue();
+    }
+
+    // Live keys whose TTL runs out within window from now
+    uint64_t expiringWithin(nanoseconds window)
+    {
+        auto now = steady_clock::now();
+        lock_guard<mutex> lock(mtx);
+        deadlines.advance(statsSlot(now));
+        return deadlines.count(deadlines.current(), statsSlot(now + window) + 1);
+    }
+
+    // counts[i] is the number of live keys expiring in
+    // [now + i * bucketWidth, now + (i + 1) * bucketWidth), to within
+    // STATS_RESOLUTION; bucketWidth is rounded up to a multiple of it
+    vector<uint64_t> expiryHistogram(nanoseconds bucketWidth, size_t buckets)
+    {
+        uint64_t width = max<uint64_t>(1, (uint64_t)((bucketWidth + STATS_RESOLUTION - nanoseconds(1)) / STATS_RESOLUTION));
+        vector<uint64_t> counts(buckets);
+        auto now = steady_clock::now();
+        lock_guard<mutex> lock(mtx);
+        deadlines.advance(statsSlot(now));
+        uint64_t from = deadlines.current();
+        for (size_t i = 0; i < buckets; ++i, from += width)
+        {
+            counts[i] = deadlines.count(from, from + width);
+        }
+        return counts;
+    }
+};
 
 /**
  * @brief Demonstrates usage of a key-value store with TTL (Time-To-Live) functionality.
  *
  * The function performs the following steps:
- * 1. Calculates a TTL duration of 1 minute in nanoseconds.
- * 2. Stores key-value pairs in `mymap` and `umap` with expiration times based on the current time plus TTL.
- * 3. Inserts two entries, waits for 100 seconds, then inserts two more entries.
- * 4. Prints the contents of both maps.
- * 5. Calls and prints the result of `get_avg()`.
- *
- * Assumes the existence of:
- * - `mymap`: a map storing key to a pair of string and expiration timestamp.
- * - `umap`: a map storing expiration timestamp to key.
- * - `get_avg()`: a function returning an average value (purpose unspecified).
+ * 1. Inserts two entries with a short TTL, waits for them to expire, then inserts two more
+ *    entries with a 1 minute TTL.
+ * 2. Prints what each key reads back and how many keys are still held.
+ * 3. For each expiry policy, loads a million keys with staggered TTLs and reports the insert
+ *    rate, a histogram of upcoming expirations and its query time, and how many keys are
+ *    still held (and how many of those are live) as they expire.
  *
  * Uses C++ chrono utilities for time calculations and thread sleep.
  */
 int main()
 {
-    long long ttl = duration_cast<nanoseconds>(minutes(1)).count();
-
-    auto now = system_clock::now();
-    long long nanos = duration_cast<nanoseconds>(
-                          now.time_since_epoch())
-                          .count();
+    TtlStore store;
 
-    mymap[1] = {"305", nanos + ttl};
-    umap[nanos + ttl] = 1;
+    store.put(1, "305", milliseconds(200));
+    store.put(2, "306", milliseconds(200));
 
-    now = system_clock::now();
-    nanos = duration_cast<nanoseconds>(
-                now.time_since_epoch())
-                .count();
+    this_thread::sleep_for(milliseconds(300));
 
-    mymap[2] = {"306", nanos + ttl};
-    umap[nanos + ttl] = 2;
+    store.put(3, "307", minutes(1));
+    store.put(4, "308", minutes(1));
 
-    this_thread::sleep_for(seconds(100));
-
-    now = system_clock::now();
-    nanos = duration_cast<nanoseconds>(
-                now.time_since_epoch())
-                .count();
-
-    mymap[3] = {"307", nanos + ttl};
-    umap[nanos + ttl] = 3;
-
-    now = system_clock::now();
-    nanos = duration_cast<nanoseconds>(
-                now.time_since_epoch())
-                .count();
-
-    mymap[4] = {"308", nanos + ttl};
-    umap[nanos + ttl] = 4;
-
-    cout << " ---- map data ---- " <<endl;
-    for (auto um : mymap)
+    cout << " ---- map data ---- " << endl;
+    for (int key = 1; key <= 4; ++key)
     {
-        cout <<um.first << " : [" << um.second.first << ", "<<um.second.second << " ]"<<endl;
+        cout << key << " : " << store.get(key).value_or("expired") << endl;
     }
-    
-    for (auto um : umap)
+    cout << "live keys: " << store.liveKeys() << ", expired: " << store.expired() << endl;
+
+    const int BULK = 1000000;
+    for (ExpiryPolicy policy : {ExpiryPolicy::TIMING_WHEEL, ExpiryPolicy::SAMPLED})
     {
-        cout << um.first << " : " << um.second << endl;
-    }
+        TtlStore bulk(policy);
+        auto start = steady_clock::now();
+        for (int i = 0; i < BULK; ++i)
+        {
+            bulk.put(i, "v", milliseconds(100 + i % 400));
+        }
+        double insertMs = duration<double, milli>(steady_clock::now() - start).count();
+        cout << (policy == ExpiryPolicy::TIMING_WHEEL ? "timing wheel" : "sampled") << ": " << BULK
+             << " TTL puts in " << insertMs << " ms (" << insertMs * 1e6 / BULK << " ns/put)" << endl;
+
+        auto queryStart = steady_clock::now();
+        vector<uint64_t> upcoming = bulk.expiryHistogram(milliseconds(100), 5);
+        uint64_t soon = bulk.expiringWithin(milliseconds(200));
+        double queryUs = duration<double, micro>(steady_clock::now() - queryStart).count();
+        cout << "  expiring per 100ms:";
+        for (uint64_t count : upcoming)
+        {
+            cout << " " << count;
+        }
+        cout << "; within 200ms: " << soon << " (queried in " << queryUs << " us)" << endl;
+        cout << "  keys held (live) after the last put at";
 
-    cout << get_avg() << endl;
+        // Every key is dead 500 ms after its put
+        auto lastPut = steady_clock::now();
+        for (int ms = 500; ms <= 2500; ms += 500)
+        {
+            this_thread::sleep_until(lastPut + milliseconds(ms));
+            cout << " +" << ms << "ms: " << bulk.size() << " (" << bulk.liveKeys() << ")";
+        }
+        ExpiryStats stats = bulk.expiryStats();
+        cout << endl << "  expired " << stats.expired << ", sampled " << stats.sampled << " in " << stats.cycles
+             << " cycles (" << stats.cyclesOverBudget << " over budget, budget now " << stats.budgetPercent << "%)" << endl;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,681 @@
+#ifndef KEY_VALUE_STORE_H
+#define KEY_VALUE_STORE_H
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include "stable_hash.h"
+#include "coarse_clock.h"
+
+/*
+Per-node stores used by the consistent-hashing key-value examples. Both
+classes expose the same interface, so ConsistentHashing<Store> can use
+either one as a drop-in:
+
+  KeyValueStore           - unordered_map behind one reader/writer lock
+  ConcurrentKeyValueStore - striped hash table with lock-free readers
+  ArenaKeyValueStore      - compact entries, short values inline, the rest
+                            in one byte arena compacted after deletes
+
+Lookups take std::string_view and do a single probe. tryGet() returns the
+value in a std::optional (one copy, no sentinel string); view() returns a
+ValueRef that borrows the stored value in place and keeps it pinned
+(read lock / read epoch) until the handle goes out of scope.
+
+KeyValueStore also takes a per-key TTL (put(key, value, ttl)); see there.
+*/
+
+// Transparent hash so string_view lookups need not build a std::string
+struct StringViewHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+// Thread-safe Key-Value Store with Consistent Hashing.
+// A TTL deadline is stored inline in the entry and checked against
+// CoarseClock, so reads never call a clock. Expired entries read as
+// absent; writes reclaim them a few buckets at a time, so keys that are
+// never read again don't pile up.
+class KeyValueStore {
+private:
+    static constexpr size_t SWEEP_BUCKETS = 2; // Buckets checked for expired entries per write
+
+    struct Entry {
+        std::string value;
+        uint64_t expiresAt = 0; // CoarseClock deadline; 0 = no TTL
+    };
+
+    using Map = std::unordered_map<std::string, Entry, StringViewHash, std::equal_to<>>;
+
+    Map store;
+    mutable std::shared_mutex rw_mutex; // Read-Write Lock
+    size_t ttlEntries = 0;              // Entries with a deadline; no sweeping while 0
+    size_t sweepCursor = 0;
+
+    // Live entry for key, or store.end() if absent or expired
+    Map::const_iterator findLocked(std::string_view key) const {
+#if defined(__cpp_lib_generic_unordered_lookup)
+        auto it = store.find(key);
+#else
+        auto it = store.find(std::string(key)); // Pre-C++20: no heterogeneous unordered lookup
+#endif
+        if (it != store.end() && CoarseClock::expired(it->second.expiresAt)) return store.end();
+        return it;
+    }
+
+    // Under the write lock
+    void assignLocked(const std::string& key, const std::string& value, uint64_t expiresAt) {
+        Entry& entry = store[key];
+        ttlEntries += (expiresAt != 0) - (entry.expiresAt != 0);
+        entry.value = value;
+        entry.expiresAt = expiresAt;
+    }
+
+    void sweepLocked() {
+        if (ttlEntries == 0) return;
+        std::string expired[4];
+        for (size_t n = 0; n < SWEEP_BUCKETS; ++n) {
+            size_t bucket = sweepCursor++ % store.bucket_count(), found = 0;
+            for (auto it = store.begin(bucket); it != store.end(bucket) && found < 4; ++it) {
+                if (CoarseClock::expired(it->second.expiresAt)) expired[found++] = it->first;
+            }
+            for (size_t i = 0; i < found; ++i) store.erase(expired[i]);
+            ttlEntries -= found;
+        }
+    }
+
+public:
+    // Borrowed value; holds the read lock while alive, so don't write to
+    // this store from the same thread while holding one.
+    class ValueRef {
+    private:
+        std::shared_lock<std::shared_mutex> lock;
+        const std::string* value;
+
+    public:
+        ValueRef(std::shared_lock<std::shared_mutex> l, const std::string* v) : lock(std::move(l)), value(v) {}
+        explicit operator bool() const { return value != nullptr; }
+        const std::string& operator*() const { return *value; }
+        const std::string* operator->() const { return value; }
+    };
+
+    void put(const std::string& key, const std::string& value) {
+        std::unique_lock lock(rw_mutex);
+        assignLocked(key, value, 0);
+        sweepLocked();
+    }
+
+    // Stores value until ttl from now; a later put without a TTL clears it
+    void put(const std::string& key, const std::string& value, std::chrono::nanoseconds ttl) {
+        std::unique_lock lock(rw_mutex);
+        assignLocked(key, value, CoarseClock::deadlineAfter(ttl));
+        sweepLocked();
+    }
+
+    std::optional<std::string> tryGet(std::string_view key) const {
+        std::shared_lock lock(rw_mutex);
+        auto it = findLocked(key);
+        if (it == store.end()) return std::nullopt;
+        return it->second.value;
+    }
+
+    ValueRef view(std::string_view key) const {
+        std::shared_lock lock(rw_mutex);
+        auto it = findLocked(key);
+        return ValueRef(std::move(lock), it == store.end() ? nullptr : &it->second.value);
+    }
+
+    std::string get(const std::string& key) {
+        return tryGet(key).value_or("Key Not Found");
+    }
+
+    void remove(const std::string& key) {
+        std::unique_lock lock(rw_mutex);
+        auto it = store.find(key);
+        if (it == store.end()) return;
+        ttlEntries -= it->second.expiresAt != 0;
+        store.erase(it);
+    }
+
+    // Batch lookup under one shared lock: for each i in indices, fills
+    // out[i] with keys[i]'s value and sets found[i] on a hit.
+    void getMany(const std::vector<std::string>& keys, const std::vector<uint32_t>& indices,
+                 std::vector<std::string>& out, std::vector<bool>& found) {
+        std::shared_lock lock(rw_mutex);
+        for (uint32_t i : indices) {
+            auto it = findLocked(keys[i]);
+            if (it != store.end()) {
+                out[i] = it->second.value;
+                found[i] = true;
+            }
+        }
+    }
+
+    // Batch insert under one exclusive lock
+    void putMany(const std::vector<std::pair<std::string, std::string>>& entries,
+                 const std::vector<uint32_t>& indices) {
+        std::unique_lock lock(rw_mutex);
+        for (uint32_t i : indices) {
+            assignLocked(entries[i].first, entries[i].second, 0);
+        }
+        sweepLocked();
+    }
+
+    // Visits every live entry under the read lock (used for snapshots)
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        std::shared_lock lock(rw_mutex);
+        for (const auto& [key, entry] : store) {
+            if (!CoarseClock::expired(entry.expiresAt)) fn(std::string_view(key), std::string_view(entry.value));
+        }
+    }
+};
+
+/*
+Concurrent store with an RCU-style read path.
+
+The table is a fixed array of buckets, each a singly linked chain whose
+links are atomic pointers. Nodes are immutable once published: an update
+links in a fresh node in place of the old one, a remove unlinks it.
+Writers serialize only on the lock stripe that owns the bucket; readers
+take no lock at all and never write shared state other than their own
+reader slot.
+
+Unlinked nodes are reclaimed with epoch-based reclamation. A reader
+announces the current epoch in a reader slot for the duration of the
+lookup; a retired node is freed once every announced epoch is newer than
+the epoch it was retired in, i.e. no reader can still be holding it.
+Reads are wait-free while there are fewer concurrent readers than
+READER_SLOTS (a reader only spins looking for a free slot beyond that).
+
+The bucket count is fixed at construction (sized from expectedKeys);
+chains just get longer if the store outgrows it.
+*/
+
+class ConcurrentKeyValueStore {
+private:
+    static constexpr size_t STRIPES = 64;
+    static constexpr size_t READER_SLOTS = 128;
+    static constexpr size_t RECLAIM_EVERY = 64;
+
+    struct Node {
+        const std::string key;
+        const std::string value;
+        std::atomic<Node*> next;
+
+        Node(const std::string& k, const std::string& v, Node* n) : key(k), value(v), next(n) {}
+    };
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0}; // 0 = not reading
+    };
+
+    struct alignas(64) Stripe {
+        std::mutex lock;
+        std::vector<std::pair<uint64_t, Node*>> retired; // (epoch, node)
+        size_t retiredSinceReclaim = 0;
+    };
+
+    std::vector<std::atomic<Node*>> buckets;
+    size_t mask;
+    Stripe stripes[STRIPES];
+
+    std::atomic<uint64_t> globalEpoch{1};
+    ReaderSlot readers[READER_SLOTS];
+
+    // Pins the current epoch for the lifetime of one read
+    class ReadGuard {
+    private:
+        ReaderSlot* slot;
+
+    public:
+        explicit ReadGuard(ConcurrentKeyValueStore& s) {
+            static std::atomic<size_t> nextThread{0};
+            thread_local size_t preferred = nextThread.fetch_add(1);
+            for (size_t i = preferred;; ++i) {
+                slot = &s.readers[i % READER_SLOTS];
+                uint64_t expected = 0;
+                if (slot->epoch.compare_exchange_strong(expected, s.globalEpoch.load())) break;
+            }
+            // The announcement must be visible before any bucket is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        // A copy would leave the epoch twice; a move hands the slot over
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ReadGuard(ReadGuard&& other) noexcept : slot(other.slot) { other.slot = nullptr; }
+        ReadGuard& operator=(ReadGuard&& other) noexcept {
+            if (this != &other) {
+                if (slot) slot->epoch.store(0, std::memory_order_release);
+                slot = other.slot;
+                other.slot = nullptr;
+            }
+            return *this;
+        }
+
+        ~ReadGuard() {
+            if (slot) slot->epoch.store(0, std::memory_order_release);
+        }
+    };
+
+    size_t bucketFor(std::string_view key) const {
+        return stablehash::hash64(key.data(), key.size()) & mask;
+    }
+
+    Stripe& stripeFor(size_t bucket) {
+        return stripes[bucket % STRIPES];
+    }
+
+    Node* find(size_t bucket, std::string_view key) const {
+        for (Node* n = buckets[bucket].load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire)) {
+            if (n->key == key) return n;
+        }
+        return nullptr;
+    }
+
+    // Replaces (or with replacement == nullptr, unlinks) node in its bucket.
+    // Caller holds the bucket's stripe lock.
+    void unlink(Stripe& stripe, size_t bucket, Node* node, Node* replacement) {
+        std::atomic<Node*>* link = &buckets[bucket];
+        while (link->load(std::memory_order_relaxed) != node) {
+            link = &link->load(std::memory_order_relaxed)->next;
+        }
+        if (replacement) {
+            replacement->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            link->store(replacement);
+        } else {
+            link->store(node->next.load(std::memory_order_relaxed));
+        }
+        retire(stripe, node);
+    }
+
+    // Retired nodes are kept per stripe, so writers never share a lock
+    // beyond their own stripe's.
+    void retire(Stripe& stripe, Node* node) {
+        stripe.retired.push_back({globalEpoch.load(), node});
+        if (++stripe.retiredSinceReclaim == RECLAIM_EVERY) {
+            stripe.retiredSinceReclaim = 0;
+            reclaim(stripe.retired);
+        }
+    }
+
+    // Frees retired nodes no active reader can still reach
+    void reclaim(std::vector<std::pair<uint64_t, Node*>>& retired) {
+        uint64_t oldestActive = globalEpoch.fetch_add(1) + 1;
+        for (auto& r : readers) {
+            uint64_t e = r.epoch.load();
+            if (e != 0 && e < oldestActive) oldestActive = e;
+        }
+        size_t kept = 0;
+        for (auto& [epoch, node] : retired) {
+            if (epoch < oldestActive) {
+                delete node;
+            } else {
+                retired[kept++] = {epoch, node};
+            }
+        }
+        retired.resize(kept);
+    }
+
+public:
+    explicit ConcurrentKeyValueStore(size_t expectedKeys = 4096) {
+        size_t count = 16;
+        while (count < expectedKeys) count <<= 1;
+        buckets = std::vector<std::atomic<Node*>>(count);
+        mask = count - 1;
+    }
+
+    ConcurrentKeyValueStore(const ConcurrentKeyValueStore&) = delete;
+    ConcurrentKeyValueStore& operator=(const ConcurrentKeyValueStore&) = delete;
+
+    ~ConcurrentKeyValueStore() {
+        for (auto& head : buckets) {
+            for (Node* n = head.load(); n;) {
+                Node* next = n->next.load();
+                delete n;
+                n = next;
+            }
+        }
+        for (auto& stripe : stripes) {
+            for (auto& entry : stripe.retired) delete entry.second;
+        }
+    }
+
+    void put(const std::string& key, const std::string& value) {
+        size_t bucket = bucketFor(key);
+        Stripe& stripe = stripeFor(bucket);
+        std::lock_guard guard(stripe.lock);
+        Node* existing = find(bucket, key);
+        if (existing) {
+            unlink(stripe, bucket, existing, new Node(key, value, nullptr));
+        } else {
+            buckets[bucket].store(new Node(key, value, buckets[bucket].load(std::memory_order_relaxed)));
+        }
+    }
+
+    // Borrowed value; keeps the node from being reclaimed while alive
+    class ValueRef {
+    private:
+        ReadGuard guard;
+        const std::string* value;
+
+    public:
+        ValueRef(ConcurrentKeyValueStore& s, std::string_view key) : guard(s) {
+            Node* n = s.find(s.bucketFor(key), key);
+            value = n ? &n->value : nullptr;
+        }
+
+        // Move-only: the value must not outlive the guard that pins it
+        ValueRef(const ValueRef&) = delete;
+        ValueRef& operator=(const ValueRef&) = delete;
+        ValueRef(ValueRef&& other) noexcept : guard(std::move(other.guard)), value(other.value) {
+            other.value = nullptr;
+        }
+        ValueRef& operator=(ValueRef&& other) noexcept {
+            if (this != &other) {
+                guard = std::move(other.guard);
+                value = other.value;
+                other.value = nullptr;
+            }
+            return *this;
+        }
+        explicit operator bool() const { return value != nullptr; }
+        const std::string& operator*() const { return *value; }
+        const std::string* operator->() const { return value; }
+    };
+
+    std::optional<std::string> tryGet(std::string_view key) {
+        ReadGuard guard(*this);
+        Node* n = find(bucketFor(key), key);
+        if (!n) return std::nullopt;
+        return n->value;
+    }
+
+    ValueRef view(std::string_view key) {
+        return ValueRef(*this, key);
+    }
+
+    std::string get(const std::string& key) {
+        return tryGet(key).value_or("Key Not Found");
+    }
+
+    void remove(const std::string& key) {
+        size_t bucket = bucketFor(key);
+        Stripe& stripe = stripeFor(bucket);
+        std::lock_guard guard(stripe.lock);
+        Node* existing = find(bucket, key);
+        if (existing) unlink(stripe, bucket, existing, nullptr);
+    }
+
+    void getMany(const std::vector<std::string>& keys, const std::vector<uint32_t>& indices,
+                 std::vector<std::string>& out, std::vector<bool>& found) {
+        ReadGuard guard(*this);
+        for (uint32_t i : indices) {
+            Node* n = find(bucketFor(keys[i]), keys[i]);
+            if (n) {
+                out[i] = n->value;
+                found[i] = true;
+            }
+        }
+    }
+
+    void putMany(const std::vector<std::pair<std::string, std::string>>& entries,
+                 const std::vector<uint32_t>& indices) {
+        for (uint32_t i : indices) put(entries[i].first, entries[i].second);
+    }
+
+    // Visits every entry without blocking writers; concurrent updates may
+    // or may not be seen
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        ReadGuard guard(*this);
+        for (auto& head : buckets) {
+            for (Node* n = head.load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire)) {
+                fn(std::string_view(n->key), std::string_view(n->value));
+            }
+        }
+    }
+};
+
+/*
+Arena-backed store for small values.
+
+Each entry is one 64-byte record in a dense vector: hash, key location,
+and either the value itself (up to INLINE_VALUE bytes, which covers most
+of our values) or its location in the arena. Keys and long values are
+appended to a single byte arena instead of being separate heap blocks.
+Entries are indexed by a linear-probing table of entry indices.
+
+remove() swaps the last entry into the hole so the entry vector stays
+dense for scans. Bytes orphaned in the arena by deletes and overwrites
+are counted, and the arena is compacted once they outweigh the live bytes.
+*/
+
+class ArenaKeyValueStore {
+private:
+    static constexpr uint32_t INLINE_VALUE = 40;
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Entry {
+        uint64_t hash;
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        uint32_t valueLength;
+        uint32_t valueOffset;           // Arena offset when valueLength > INLINE_VALUE
+        char inlineValue[INLINE_VALUE]; // Value bytes when valueLength <= INLINE_VALUE
+    };
+    static_assert(sizeof(Entry) == 64, "Entry should fill one cache line");
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> table; // Bucket -> entry index
+    size_t mask = 0;
+    std::vector<char> arena;
+    size_t deadBytes = 0;
+    mutable std::shared_mutex rw_mutex;
+
+    std::string_view keyOf(const Entry& e) const {
+        return std::string_view(arena.data() + e.keyOffset, e.keyLength);
+    }
+
+    std::string_view valueOf(const Entry& e) const {
+        if (e.valueLength <= INLINE_VALUE) return std::string_view(e.inlineValue, e.valueLength);
+        return std::string_view(arena.data() + e.valueOffset, e.valueLength);
+    }
+
+    uint32_t append(std::string_view bytes) {
+        uint32_t offset = arena.size();
+        arena.insert(arena.end(), bytes.begin(), bytes.end());
+        return offset;
+    }
+
+    void setValue(Entry& e, std::string_view value) {
+        if (e.valueLength > INLINE_VALUE) deadBytes += e.valueLength;
+        e.valueLength = value.size();
+        if (value.size() <= INLINE_VALUE) {
+            std::memcpy(e.inlineValue, value.data(), value.size());
+        } else {
+            e.valueOffset = append(value);
+        }
+    }
+
+    // Bucket holding key, or EMPTY if absent
+    uint32_t findBucket(std::string_view key, uint64_t h) const {
+        if (table.empty()) return EMPTY;
+        for (size_t pos = h & mask;; pos = (pos + 1) & mask) {
+            uint32_t idx = table[pos];
+            if (idx == EMPTY) return EMPTY;
+            if (entries[idx].hash == h && keyOf(entries[idx]) == key) return pos;
+        }
+    }
+
+    void insertBucket(uint32_t idx) {
+        size_t pos = entries[idx].hash & mask;
+        while (table[pos] != EMPTY) pos = (pos + 1) & mask;
+        table[pos] = idx;
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    void eraseBucket(size_t hole) {
+        table[hole] = EMPTY;
+        for (size_t j = (hole + 1) & mask; table[j] != EMPTY; j = (j + 1) & mask) {
+            size_t home = entries[table[j]].hash & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                table[hole] = table[j];
+                table[j] = EMPTY;
+                hole = j;
+            }
+        }
+    }
+
+    void growTable() {
+        size_t buckets = std::max<size_t>(16, table.size() * 2);
+        table.assign(buckets, EMPTY);
+        mask = buckets - 1;
+        for (uint32_t i = 0; i < entries.size(); ++i) insertBucket(i);
+    }
+
+    // Rewrites the arena with only live keys and values
+    void compact() {
+        std::vector<char> fresh;
+        fresh.reserve(arena.size() - deadBytes);
+        for (Entry& e : entries) {
+            uint32_t keyOffset = fresh.size();
+            fresh.insert(fresh.end(), arena.begin() + e.keyOffset, arena.begin() + e.keyOffset + e.keyLength);
+            e.keyOffset = keyOffset;
+            if (e.valueLength > INLINE_VALUE) {
+                uint32_t valueOffset = fresh.size();
+                fresh.insert(fresh.end(), arena.begin() + e.valueOffset, arena.begin() + e.valueOffset + e.valueLength);
+                e.valueOffset = valueOffset;
+            }
+        }
+        arena.swap(fresh);
+        deadBytes = 0;
+    }
+
+    void putLocked(std::string_view key, std::string_view value) {
+        uint64_t h = stablehash::hash64(key.data(), key.size());
+        uint32_t pos = findBucket(key, h);
+        if (pos != EMPTY) {
+            setValue(entries[table[pos]], value);
+        } else {
+            if ((entries.size() + 1) * 2 > table.size()) growTable(); // Load factor <= 0.5
+            Entry e{};
+            e.hash = h;
+            e.keyLength = key.size();
+            e.keyOffset = append(key);
+            setValue(e, value);
+            entries.push_back(e);
+            insertBucket(entries.size() - 1);
+        }
+        if (deadBytes > 4096 && deadBytes * 2 > arena.size()) compact();
+    }
+
+public:
+    // Borrowed value (inline or in the arena); holds the read lock while alive
+    class ValueRef {
+    private:
+        std::shared_lock<std::shared_mutex> lock;
+        std::string_view value;
+        bool found;
+
+    public:
+        ValueRef(std::shared_lock<std::shared_mutex> l, std::string_view v, bool f)
+            : lock(std::move(l)), value(v), found(f) {}
+        explicit operator bool() const { return found; }
+        std::string_view operator*() const { return value; }
+        const std::string_view* operator->() const { return &value; }
+    };
+
+    void put(const std::string& key, const std::string& value) {
+        std::unique_lock lock(rw_mutex);
+        putLocked(key, value);
+    }
+
+    std::optional<std::string> tryGet(std::string_view key) const {
+        std::shared_lock lock(rw_mutex);
+        uint32_t pos = findBucket(key, stablehash::hash64(key.data(), key.size()));
+        if (pos == EMPTY) return std::nullopt;
+        return std::string(valueOf(entries[table[pos]]));
+    }
+
+    ValueRef view(std::string_view key) const {
+        std::shared_lock lock(rw_mutex);
+        uint32_t pos = findBucket(key, stablehash::hash64(key.data(), key.size()));
+        if (pos == EMPTY) return ValueRef(std::move(lock), {}, false);
+        return ValueRef(std::move(lock), valueOf(entries[table[pos]]), true);
+    }
+
+    std::string get(const std::string& key) {
+        return tryGet(key).value_or("Key Not Found");
+    }
+
+    void remove(const std::string& key) {
+        std::unique_lock lock(rw_mutex);
+        uint32_t pos = findBucket(key, stablehash::hash64(key.data(), key.size()));
+        if (pos == EMPTY) return;
+
+        uint32_t idx = table[pos];
+        Entry& e = entries[idx];
+        deadBytes += e.keyLength + (e.valueLength > INLINE_VALUE ? e.valueLength : 0);
+        eraseBucket(pos);
+
+        uint32_t last = entries.size() - 1;
+        if (idx != last) {
+            // Move the last entry into the hole and repoint its bucket
+            uint32_t lastPos = findBucket(keyOf(entries[last]), entries[last].hash);
+            entries[idx] = entries[last];
+            table[lastPos] = idx;
+        }
+        entries.pop_back();
+        if (deadBytes > 4096 && deadBytes * 2 > arena.size()) compact();
+    }
+
+    void getMany(const std::vector<std::string>& keys, const std::vector<uint32_t>& indices,
+                 std::vector<std::string>& out, std::vector<bool>& found) {
+        std::shared_lock lock(rw_mutex);
+        for (uint32_t i : indices) {
+            uint32_t pos = findBucket(keys[i], stablehash::hash64(keys[i]));
+            if (pos != EMPTY) {
+                out[i] = std::string(valueOf(entries[table[pos]]));
+                found[i] = true;
+            }
+        }
+    }
+
+    void putMany(const std::vector<std::pair<std::string, std::string>>& entriesToPut,
+                 const std::vector<uint32_t>& indices) {
+        std::unique_lock lock(rw_mutex);
+        for (uint32_t i : indices) putLocked(entriesToPut[i].first, entriesToPut[i].second);
+    }
+
+    // Sequential scan over the dense entry array
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        std::shared_lock lock(rw_mutex);
+        for (const Entry& e : entries) fn(keyOf(e), valueOf(e));
+    }
+
+    size_t size() const {
+        std::shared_lock lock(rw_mutex);
+        return entries.size();
+    }
+
+    // Approximate resident bytes: entries, index and arena
+    size_t bytesUsed() const {
+        std::shared_lock lock(rw_mutex);
+        return entries.capacity() * sizeof(Entry) + table.size() * sizeof(uint32_t) + arena.capacity();
+    }
+};
+
+#endif // KEY_VALUE_STORE_H
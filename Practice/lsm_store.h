@@ -0,0 +1,560 @@
+#ifndef LSM_STORE_H
+#define LSM_STORE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "stable_hash.h"
+
+/*
+Local log-structured merge store, used as the backing storage of the
+distributed LRU cache.
+
+Writes go to an in-memory sorted memtable. When it passes memtableLimit
+bytes it is frozen (still readable) and a background thread writes it out
+as an immutable sorted run. When RUNS_BEFORE_COMPACTION runs pile up the
+same thread merges them into one, keeping the newest version of each key
+and dropping deletes.
+
+Run file layout (little-endian):
+  Data    entries sorted by key:
+          u8 tombstone | u32 keyLength | u32 valueLength | key | value
+  Index   per block of BLOCK_ENTRIES entries: u32 keyLength | first key | u64 offset
+  Bloom   bloomBits / 8 bytes
+  Footer  u64 indexOffset | u64 bloomOffset | u64 entryCount | u32 blockCount
+          | u32 bloomHashes | u64 bloomBits | u64 magic
+
+A run's index and bloom filter are held in memory, so a point lookup
+touches disk at most once per run, and not at all for runs whose bloom
+filter rules the key out (~1% false positives at 10 bits per key).
+
+The memtable is not logged: a clean shutdown flushes it, a crash loses
+it. Pair with a WriteAheadLog when that matters.
+
+A failed flush keeps its memtable frozen, so reads still see it, and is
+retried with exponential backoff. While flushes are failing, writers
+that would stall behind MAX_FROZEN memtables get false back instead of
+waiting forever. The store never prints: lastError() says what failed
+last and stats() counts the failures. Memtables still unflushed at
+shutdown are lost; flush() before destroying the store to find out.
+*/
+
+struct LsmStats {
+    uint64_t bloomSkips = 0;  // Runs skipped by their bloom filter
+    uint64_t diskReads = 0;   // Blocks read with pread
+    uint64_t flushes = 0;
+    uint64_t compactions = 0;
+    uint64_t failedFlushes = 0;     // Attempts, so a retried flush counts once per try
+    uint64_t failedCompactions = 0;
+};
+
+class LsmStore {
+private:
+    static constexpr uint64_t MAGIC = 0x4C534D52554E3031ULL; // "LSMRUN01"
+    static constexpr size_t FOOTER = 5 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    static constexpr uint32_t BLOCK_ENTRIES = 16;
+    static constexpr uint32_t BLOOM_BITS_PER_KEY = 10;
+    static constexpr uint32_t BLOOM_HASHES = 7;
+    static constexpr size_t RUNS_BEFORE_COMPACTION = 4;
+    static constexpr size_t MAX_FROZEN = 4;    // Writers stall past this many unflushed memtables
+    static constexpr std::chrono::milliseconds MIN_RETRY{10}, MAX_RETRY{2000}; // Failed flush backoff
+
+    using Memtable = std::map<std::string, std::optional<std::string>, std::less<>>; // nullopt = delete
+
+    template <typename T>
+    static T load(const char* p) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    template <typename T>
+    static void store(std::string& out, T v) {
+        out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    // Bloom bit positions by double hashing: h + i * h2
+    static void bloomAdd(std::string& bits, uint64_t bitCount, uint64_t h) {
+        uint64_t h2 = (h >> 32) | 1;
+        for (uint32_t i = 0; i < BLOOM_HASHES; ++i, h += h2) {
+            uint64_t bit = h % bitCount;
+            bits[bit >> 3] |= char(1 << (bit & 7));
+        }
+    }
+
+    static bool bloomMayContain(const std::string& bits, uint64_t bitCount, uint64_t h) {
+        uint64_t h2 = (h >> 32) | 1;
+        for (uint32_t i = 0; i < BLOOM_HASHES; ++i, h += h2) {
+            uint64_t bit = h % bitCount;
+            if (!(bits[bit >> 3] & (1 << (bit & 7)))) return false;
+        }
+        return true;
+    }
+
+    // Serialises one run; entries must be added in key order
+    class RunWriter {
+    private:
+        std::string out;
+        std::string index;
+        std::vector<uint64_t> keyHashes;
+        uint32_t blockCount = 0;
+
+    public:
+        void add(std::string_view key, const std::optional<std::string_view>& value) {
+            if (keyHashes.size() % BLOCK_ENTRIES == 0) {
+                store<uint32_t>(index, key.size());
+                index.append(key);
+                store<uint64_t>(index, out.size());
+                ++blockCount;
+            }
+            keyHashes.push_back(stablehash::hash64(key.data(), key.size()));
+            out.push_back(value ? 0 : 1);
+            store<uint32_t>(out, key.size());
+            store<uint32_t>(out, value ? value->size() : 0);
+            out.append(key);
+            if (value) out.append(*value);
+        }
+
+        size_t entries() const { return keyHashes.size(); }
+
+        // Writes to a temp file, fsyncs and renames into place
+        bool finish(const std::string& path) {
+            uint64_t indexOffset = out.size();
+            out += index;
+            uint64_t bloomOffset = out.size();
+            uint64_t bloomBits = std::max<uint64_t>(64, keyHashes.size() * BLOOM_BITS_PER_KEY);
+            std::string bloom((bloomBits + 7) / 8, '\0');
+            for (uint64_t h : keyHashes) bloomAdd(bloom, bloomBits, h);
+            out += bloom;
+            store<uint64_t>(out, indexOffset);
+            store<uint64_t>(out, bloomOffset);
+            store<uint64_t>(out, keyHashes.size());
+            store<uint32_t>(out, blockCount);
+            store<uint32_t>(out, BLOOM_HASHES);
+            store<uint64_t>(out, bloomBits);
+            store<uint64_t>(out, MAGIC);
+
+            std::string tmp = path + ".tmp";
+            int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            size_t written = 0;
+            while (written < out.size()) {
+                ssize_t n = ::write(fd, out.data() + written, out.size() - written);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                written += n;
+            }
+            bool ok = written == out.size() && ::fsync(fd) == 0;
+            int err = errno;
+            ::close(fd);
+            if (ok && std::rename(tmp.c_str(), path.c_str()) == 0) return true;
+            if (ok) err = errno;
+            std::remove(tmp.c_str());
+            errno = err;
+            return false;
+        }
+    };
+
+    // One immutable sorted run on disk; index and bloom filter in memory
+    class Run {
+    private:
+        int fd = -1;
+        std::vector<std::string> firstKeys;
+        std::vector<uint64_t> blockOffsets; // blockCount + 1, last is the data end
+        std::string bloom;
+        uint64_t bloomBits = 0;
+
+    public:
+        const std::string path;
+        const uint64_t sequence;
+        uint64_t entryCount = 0;
+
+        Run(const std::string& runPath, uint64_t seq) : path(runPath), sequence(seq) {
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw std::runtime_error("cannot open run " + path);
+            off_t size = ::lseek(fd, 0, SEEK_END);
+            char footer[FOOTER];
+            if (size < (off_t)FOOTER || ::pread(fd, footer, FOOTER, size - FOOTER) != (ssize_t)FOOTER ||
+                load<uint64_t>(footer + FOOTER - 8) != MAGIC) {
+                ::close(fd);
+                throw std::runtime_error("bad run " + path);
+            }
+            uint64_t indexOffset = load<uint64_t>(footer);
+            uint64_t bloomOffset = load<uint64_t>(footer + 8);
+            entryCount = load<uint64_t>(footer + 16);
+            uint32_t blockCount = load<uint32_t>(footer + 24);
+            bloomBits = load<uint64_t>(footer + 32);
+
+            std::string meta(size - FOOTER - indexOffset, '\0');
+            if (::pread(fd, meta.data(), meta.size(), indexOffset) != (ssize_t)meta.size()) {
+                ::close(fd);
+                throw std::runtime_error("bad run " + path);
+            }
+            const char* p = meta.data();
+            for (uint32_t b = 0; b < blockCount; ++b) {
+                uint32_t keyLength = load<uint32_t>(p);
+                firstKeys.emplace_back(p + 4, keyLength);
+                blockOffsets.push_back(load<uint64_t>(p + 4 + keyLength));
+                p += 4 + keyLength + 8;
+            }
+            blockOffsets.push_back(indexOffset);
+            bloom.assign(meta.data() + (bloomOffset - indexOffset), (bloomBits + 7) / 8);
+        }
+
+        Run(const Run&) = delete;
+        Run& operator=(const Run&) = delete;
+
+        ~Run() {
+            if (fd >= 0) ::close(fd);
+        }
+
+        bool mayContain(std::string_view key) const {
+            return bloomMayContain(bloom, bloomBits, stablehash::hash64(key.data(), key.size()));
+        }
+
+        // Reads one data block: empty when none can hold key
+        std::string readBlockFor(std::string_view key) const {
+            auto it = std::upper_bound(firstKeys.begin(), firstKeys.end(), key,
+                                       [](std::string_view k, const std::string& first) { return k < first; });
+            if (it == firstKeys.begin()) return {};
+            size_t b = (it - firstKeys.begin()) - 1;
+            std::string block(blockOffsets[b + 1] - blockOffsets[b], '\0');
+            if (::pread(fd, block.data(), block.size(), blockOffsets[b]) != (ssize_t)block.size()) return {};
+            return block;
+        }
+
+        // Whole data section, for compaction
+        std::string readAll() const {
+            std::string data(blockOffsets.back(), '\0');
+            if (::pread(fd, data.data(), data.size(), 0) != (ssize_t)data.size()) data.clear();
+            return data;
+        }
+    };
+
+    // Walks the entries of a data block or section
+    struct EntryCursor {
+        const std::string* data;
+        size_t offset = 0;
+
+        bool valid() const { return offset + 9 <= data->size(); }
+        bool tombstone() const { return (*data)[offset] != 0; }
+        std::string_view key() const {
+            return std::string_view(data->data() + offset + 9, load<uint32_t>(data->data() + offset + 1));
+        }
+        std::string_view value() const {
+            uint32_t keyLength = load<uint32_t>(data->data() + offset + 1);
+            return std::string_view(data->data() + offset + 9 + keyLength, load<uint32_t>(data->data() + offset + 5));
+        }
+        void next() { offset += 9 + key().size() + value().size(); }
+    };
+
+    const std::string directory;
+    const size_t memtableLimit;
+
+    mutable std::shared_mutex mtx;           // Guards memtable, frozen, runs
+    Memtable memtable;
+    size_t memtableBytes = 0;
+    std::deque<std::shared_ptr<const Memtable>> frozen; // Newest first, awaiting flush
+    std::vector<std::shared_ptr<Run>> runs;             // Newest first
+    uint64_t nextSequence = 1;
+
+    std::condition_variable_any workCv;      // Background thread waits for work
+    std::condition_variable_any flushedCv;   // Stalled writers / flush() wait for flushes
+    bool stopping = false;
+    bool compactionFailed = false;
+    bool flushFailing = false;               // Last flush attempt failed; cleared by a good one
+    std::chrono::milliseconds retryDelay = MIN_RETRY;
+    std::string error;                       // Last flush/compaction failure
+    std::thread background;
+
+    mutable std::atomic<uint64_t> bloomSkips{0}, diskReads{0};
+    std::atomic<uint64_t> flushes{0}, compactions{0}, failedFlushes{0}, failedCompactions{0};
+
+    std::string runPath(uint64_t seq) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "run-%08llu.sst", (unsigned long long)seq);
+        return directory + "/" + name;
+    }
+
+    // Caller holds mtx exclusively
+    void freezeMemtable() {
+        if (memtable.empty()) return;
+        frozen.push_front(std::make_shared<const Memtable>(std::move(memtable)));
+        memtable.clear();
+        memtableBytes = 0;
+        workCv.notify_one();
+    }
+
+    static std::optional<std::optional<std::string>> findIn(const Memtable& table, std::string_view key) {
+        auto it = table.find(key);
+        if (it == table.end()) return std::nullopt;
+        return it->second;
+    }
+
+    // Writes and opens the run; null (with why set) on failure. Never
+    // throws, since it runs on the background thread.
+    std::shared_ptr<Run> writeRun(RunWriter& writer, uint64_t seq, std::string& why) {
+        try {
+            if (writer.finish(runPath(seq))) return std::make_shared<Run>(runPath(seq), seq);
+            why = std::strerror(errno);
+        } catch (const std::exception& e) {
+            why = e.what();
+        }
+        return nullptr;
+    }
+
+    // Returns false if the flush failed; the table then stays frozen and
+    // the caller backs off before trying again
+    bool flushOldest(std::unique_lock<std::shared_mutex>& lock) {
+        std::shared_ptr<const Memtable> table = frozen.back();
+        uint64_t seq = nextSequence++;
+        lock.unlock();
+
+        std::shared_ptr<Run> run;
+        std::string why;
+        try {
+            RunWriter writer;
+            for (const auto& [key, value] : *table) {
+                writer.add(key, value ? std::optional<std::string_view>(*value) : std::nullopt);
+            }
+            run = writeRun(writer, seq, why);
+        } catch (const std::exception& e) { // e.g. bad_alloc building the run
+            why = e.what();
+        }
+
+        lock.lock();
+        if (!run) {
+            failedFlushes.fetch_add(1, std::memory_order_relaxed);
+            flushFailing = true;
+            error = "flush: " + why;
+            flushedCv.notify_all(); // Stalled writers and flush() give up instead of waiting
+            return false;
+        }
+        runs.insert(runs.begin(), run);
+        frozen.pop_back();
+        flushFailing = false;
+        retryDelay = MIN_RETRY;
+        flushes.fetch_add(1, std::memory_order_relaxed);
+        flushedCv.notify_all();
+        return true;
+    }
+
+    // Merges every current run into one; runs flushed meanwhile are newer
+    // and stay in front of the result
+    void compact(std::unique_lock<std::shared_mutex>& lock) {
+        std::vector<std::shared_ptr<Run>> inputs = runs; // Newest first
+        uint64_t seq = nextSequence++;
+        lock.unlock();
+
+        std::vector<std::string> data(inputs.size());
+        std::vector<EntryCursor> cursors;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            data[i] = inputs[i]->readAll();
+            cursors.push_back(EntryCursor{&data[i]});
+        }
+        RunWriter writer;
+        while (true) {
+            // Smallest key across runs; on ties the newest run (lowest i) wins
+            int pick = -1;
+            for (size_t i = 0; i < cursors.size(); ++i) {
+                if (cursors[i].valid() && (pick < 0 || cursors[i].key() < cursors[pick].key())) pick = i;
+            }
+            if (pick < 0) break;
+            std::string key(cursors[pick].key());
+            // All runs are merged, so nothing older can hide behind a delete
+            if (!cursors[pick].tombstone()) writer.add(key, cursors[pick].value());
+            for (auto& c : cursors) {
+                if (c.valid() && c.key() == key) c.next();
+            }
+        }
+
+        std::string why;
+        std::shared_ptr<Run> merged = writeRun(writer, seq, why);
+
+        lock.lock();
+        if (!merged) {
+            failedCompactions.fetch_add(1, std::memory_order_relaxed);
+            error = "compaction: " + why;
+            compactionFailed = true; // Don't spin on a full or broken disk
+            flushedCv.notify_all();
+            return;
+        }
+        runs.erase(runs.end() - inputs.size(), runs.end());
+        if (writer.entries() > 0) runs.push_back(merged);
+        else std::remove(merged->path.c_str());
+        // Open readers keep their file descriptors; unlinking is safe
+        for (const auto& run : inputs) std::remove(run->path.c_str());
+        compactions.fetch_add(1, std::memory_order_relaxed);
+        flushedCv.notify_all();
+    }
+
+    // Stalls a writer while MAX_FROZEN memtables await flushing; false
+    // once flushes are failing and there is still no room
+    bool waitForRoom(std::unique_lock<std::shared_mutex>& lock) {
+        flushedCv.wait(lock, [this] { return frozen.size() < MAX_FROZEN || flushFailing; });
+        return frozen.size() < MAX_FROZEN;
+    }
+
+    void backgroundLoop() {
+        std::unique_lock lock(mtx);
+        while (true) {
+            workCv.wait(lock, [this] {
+                return stopping || !frozen.empty() || (runs.size() >= RUNS_BEFORE_COMPACTION && !compactionFailed);
+            });
+            // Flushes come first, but not to the point of starving
+            // compaction while a long write burst keeps adding runs
+            bool compactDue = runs.size() >= RUNS_BEFORE_COMPACTION && !stopping && !compactionFailed;
+            if (compactDue && (frozen.empty() || runs.size() >= 2 * RUNS_BEFORE_COMPACTION)) {
+                compact(lock);
+            } else if (!frozen.empty()) {
+                if (flushOldest(lock)) continue;
+                if (stopping) return; // Unflushed memtables are lost; flush() reports it first
+                workCv.wait_for(lock, retryDelay, [this] { return stopping; });
+                retryDelay = std::min(retryDelay * 2, MAX_RETRY);
+            } else if (stopping) {
+                return;
+            }
+        }
+    }
+
+public:
+    // Opens (or creates) the store in dir, picking up the runs already there
+    explicit LsmStore(const std::string& dir, size_t memtableBytesLimit = 1 << 20)
+        : directory(dir), memtableLimit(memtableBytesLimit) {
+        std::filesystem::create_directories(directory);
+        std::vector<std::pair<uint64_t, std::string>> found;
+        for (const auto& file : std::filesystem::directory_iterator(directory)) {
+            std::string name = file.path().filename().string();
+            unsigned long long seq;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+                std::filesystem::remove(file.path()); // Interrupted flush
+            } else if (std::sscanf(name.c_str(), "run-%llu.sst", &seq) == 1) {
+                found.emplace_back(seq, file.path().string());
+            }
+        }
+        std::sort(found.rbegin(), found.rend());
+        for (const auto& [seq, path] : found) {
+            runs.push_back(std::make_shared<Run>(path, seq));
+            nextSequence = std::max<uint64_t>(nextSequence, seq + 1);
+        }
+        background = std::thread(&LsmStore::backgroundLoop, this);
+    }
+
+    LsmStore(const LsmStore&) = delete;
+    LsmStore& operator=(const LsmStore&) = delete;
+
+    // Flushes the memtable so a clean restart loses nothing
+    ~LsmStore() {
+        {
+            std::unique_lock lock(mtx);
+            freezeMemtable();
+            stopping = true;
+        }
+        workCv.notify_one();
+        background.join();
+    }
+
+    // False, with nothing written, if the store is full of memtables that
+    // cannot be flushed (see lastError())
+    bool put(const std::string& key, const std::string& value) {
+        std::unique_lock lock(mtx);
+        if (!waitForRoom(lock)) return false;
+        memtable[key] = value;
+        memtableBytes += key.size() + value.size() + 64;
+        if (memtableBytes >= memtableLimit) freezeMemtable();
+        return true;
+    }
+
+    bool remove(const std::string& key) {
+        std::unique_lock lock(mtx);
+        if (!waitForRoom(lock)) return false;
+        memtable[key] = std::nullopt;
+        memtableBytes += key.size() + 64;
+        if (memtableBytes >= memtableLimit) freezeMemtable();
+        return true;
+    }
+
+    // Memtable, then frozen memtables, then runs, newest first; the first
+    // version found (value or delete) is the answer
+    std::optional<std::string> get(std::string_view key) const {
+        std::vector<std::shared_ptr<Run>> candidates;
+        {
+            std::shared_lock lock(mtx);
+            if (auto hit = findIn(memtable, key)) return *hit;
+            for (const auto& table : frozen) {
+                if (auto hit = findIn(*table, key)) return *hit;
+            }
+            candidates = runs;
+        }
+        for (const auto& run : candidates) {
+            if (!run->mayContain(key)) {
+                bloomSkips.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            diskReads.fetch_add(1, std::memory_order_relaxed);
+            std::string block = run->readBlockFor(key);
+            for (EntryCursor c{&block}; c.valid(); c.next()) {
+                if (c.key() == key) {
+                    if (c.tombstone()) return std::nullopt;
+                    return std::string(c.value());
+                }
+                if (c.key() > key) break;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Freezes the memtable and waits until everything is in runs and no
+    // compaction is pending. False if a flush failed meanwhile.
+    bool flush() {
+        std::unique_lock lock(mtx);
+        freezeMemtable();
+        flushedCv.wait(lock, [this] {
+            return flushFailing || (frozen.empty() && (runs.size() < RUNS_BEFORE_COMPACTION || compactionFailed));
+        });
+        return frozen.empty();
+    }
+
+    // Last flush or compaction failure, empty if none
+    std::string lastError() const {
+        std::shared_lock lock(mtx);
+        return error;
+    }
+
+    size_t runCount() const {
+        std::shared_lock lock(mtx);
+        return runs.size();
+    }
+
+    LsmStats stats() const {
+        LsmStats s;
+        s.bloomSkips = bloomSkips.load(std::memory_order_relaxed);
+        s.diskReads = diskReads.load(std::memory_order_relaxed);
+        s.flushes = flushes.load(std::memory_order_relaxed);
+        s.compactions = compactions.load(std::memory_order_relaxed);
+        s.failedFlushes = failedFlushes.load(std::memory_order_relaxed);
+        s.failedCompactions = failedCompactions.load(std::memory_order_relaxed);
+        return s;
+    }
+};
+
+#endif // LSM_STORE_H
@@ -0,0 +1,134 @@
+#ifndef REBALANCER_H
+#define REBALANCER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+#include <optional>
+#include <functional>
+#include <thread>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+/*
+Bookkeeping for moving keys after a topology change. The owner class
+switches its ring first, then start()s a migration job on a background
+thread that copies the affected keys to their new owners in batches of
+BATCH_SIZE, pausing between batches. Which keys are affected is the
+owner's call; HashRing::movedRanges() narrows it to the hash ranges whose
+replicas changed.
+
+While the job runs:
+  - writes call noteWrite(key) before touching the new owner; the job
+    skips those keys, so a copy never overwrites a newer value and a
+    delete is never undone
+  - reads that miss on the new owner go through readOld() to the old
+    owner, unless the key was written since the move began
+
+finish() ends the handoff under the exclusive lock, after which no read
+falls back to the old owner and the job may delete the moved copies.
+*/
+
+struct RebalanceStats {
+    uint64_t movedKeys = 0;
+    uint64_t skippedKeys = 0; // Written during the move, so not copied
+    uint64_t batches = 0;
+    bool active = false;
+};
+
+class Rebalancer {
+private:
+    mutable std::shared_mutex mtx;   // Exclusive for writes/copies/finish, shared for fallback reads
+    std::atomic<bool> active{false};
+    std::unordered_set<std::string> touched;
+    std::thread job;
+    std::atomic<uint64_t> movedKeys{0}, skippedKeys{0}, batches{0};
+
+public:
+    static constexpr size_t BATCH_SIZE = 256;
+    static constexpr std::chrono::microseconds BATCH_PAUSE{200}; // Leaves room for foreground traffic
+
+    Rebalancer() = default;
+    Rebalancer(const Rebalancer&) = delete;
+    Rebalancer& operator=(const Rebalancer&) = delete;
+
+    ~Rebalancer() { wait(); }
+
+    // Starts serving fallback reads and runs migrate() in the background
+    void start(std::function<void()> migrate) {
+        wait();
+        {
+            std::unique_lock lock(mtx);
+            touched.clear();
+            active.store(true, std::memory_order_release);
+        }
+        job = std::thread(std::move(migrate));
+    }
+
+    void wait() {
+        if (job.joinable()) job.join();
+    }
+
+    bool isActive() const { return active.load(std::memory_order_acquire); }
+
+    void noteWrite(const std::string& key) {
+        if (!isActive()) return;
+        std::unique_lock lock(mtx);
+        if (isActive()) touched.insert(key);
+    }
+
+    // read() against the old owner, if the key may still only live there
+    template <typename Read>
+    std::optional<std::string> readOld(std::string_view key, Read&& read) const {
+        if (!isActive()) return std::nullopt;
+        std::shared_lock lock(mtx);
+        if (!isActive() || touched.count(std::string(key))) return std::nullopt;
+        return read();
+    }
+
+    // copy(key) for every key in the batch not written since the move began.
+    // The lock is held for one key's check and copy at a time, so a writer
+    // waits behind at most one copy, not the whole batch.
+    template <typename Copy>
+    void copyBatch(const std::vector<std::string>& keys, size_t begin, size_t end, Copy&& copy) {
+        for (size_t i = begin; i < end; ++i) {
+            std::unique_lock lock(mtx);
+            if (touched.count(keys[i])) {
+                skippedKeys.fetch_add(1, std::memory_order_relaxed);
+            } else if (copy(keys[i])) {
+                movedKeys.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        batches.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::sleep_for(BATCH_PAUSE);
+    }
+
+    template <typename Copy>
+    void copyAll(const std::vector<std::string>& keys, Copy&& copy) {
+        for (size_t begin = 0; begin < keys.size(); begin += BATCH_SIZE) {
+            copyBatch(keys, begin, std::min(keys.size(), begin + BATCH_SIZE), copy);
+        }
+    }
+
+    // Handoff complete: reads stop falling back to the old owners
+    void finish() {
+        std::unique_lock lock(mtx);
+        active.store(false, std::memory_order_release);
+        touched.clear();
+    }
+
+    RebalanceStats stats() const {
+        RebalanceStats s;
+        s.movedKeys = movedKeys.load(std::memory_order_relaxed);
+        s.skippedKeys = skippedKeys.load(std::memory_order_relaxed);
+        s.batches = batches.load(std::memory_order_relaxed);
+        s.active = isActive();
+        return s;
+    }
+};
+
+#endif // REBALANCER_H
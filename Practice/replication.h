@@ -0,0 +1,348 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+enum class ReplicationMode {
+    SYNC,  // Caller writes every replica itself
+    ASYNC  // Caller writes the primary; replica writes go to per-node workers
+};
+
+/*
+Replicated values carry a version so readers that see several replicas
+can tell which copy is newest. Deletes are versioned too (a tombstone),
+otherwise a replica that missed the delete would resurrect the key.
+Tombstones stay until the owner purges them, once every replica is known
+to hold the same one (see purgeTombstones in the enhanced example).
+
+Stored layout: u64 version | u8 deleted | value
+*/
+
+struct VersionedValue {
+    uint64_t version = 0;
+    bool deleted = false;
+    std::string value;
+
+    static std::string encode(uint64_t version, bool deleted, std::string_view value = {}) {
+        std::string out(sizeof(version) + 1 + value.size(), '\0');
+        std::memcpy(&out[0], &version, sizeof(version));
+        out[sizeof(version)] = deleted;
+        if (!value.empty()) std::memcpy(&out[sizeof(version) + 1], value.data(), value.size());
+        return out;
+    }
+
+    static VersionedValue decode(std::string_view raw) {
+        VersionedValue v;
+        if (raw.size() < sizeof(v.version) + 1) return v;
+        std::memcpy(&v.version, raw.data(), sizeof(v.version));
+        v.deleted = raw[sizeof(v.version)] != 0;
+        v.value.assign(raw.substr(sizeof(v.version) + 1));
+        return v;
+    }
+};
+
+namespace replication {
+
+// Store writes return void (in-memory stores cannot fail) or bool
+// (DurableKeyValueStore: false if not logged durably); true if write()
+// succeeded either way
+template <typename Write>
+bool applied(Write&& write) {
+    if constexpr (std::is_void_v<std::invoke_result_t<Write>>) {
+        write();
+        return true;
+    } else {
+        return write();
+    }
+}
+
+} // namespace replication
+
+// Shared by the replica copies of one write; the caller waits on it for a
+// W-of-N quorum. A copy the replica's store refused reports fail(), so a
+// failed write is never counted towards the quorum.
+struct WriteAck {
+    std::mutex m;
+    std::condition_variable cv;
+    const int copies; // Copies that will report
+    int acked = 0;
+    int failed = 0;
+
+    explicit WriteAck(int replicaCopies) : copies(replicaCopies) {}
+
+    void ack() { report(true); }
+    void fail() { report(false); }
+
+private:
+    void report(bool ok) {
+        {
+            std::lock_guard lock(m);
+            ++(ok ? acked : failed);
+        }
+        cv.notify_all();
+    }
+
+public:
+    // True once count copies are applied, false as soon as too many have
+    // failed for that to happen
+    bool waitFor(int count) {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return acked >= count || copies - failed < count; });
+        return acked >= count;
+    }
+};
+
+struct ReplicaLag {
+    size_t queued = 0;           // Writes waiting for this replica
+    uint64_t applied = 0;        // Writes applied so far
+    double oldestPendingMs = 0;  // Age of the oldest queued write
+    double lastBatchLagMs = 0;   // Enqueue-to-apply time of the last batch's oldest write
+    double maxBatchLagMs = 0;
+};
+
+/*
+Replication queue for one node. Writes are applied in FIFO order, so a
+replica sees each key's updates in the order the primary did. The worker
+drains up to MAX_BATCH writes at a time and hands them to the store's
+putMany in queue order, so one lock acquisition covers the whole batch.
+Deletes arrive as tombstone puts. A batch the store refuses fails the
+WriteAck of every write in it instead of acking it.
+*/
+
+template <typename Store>
+class ReplicationWorker {
+private:
+    static constexpr size_t MAX_BATCH = 256;
+
+    struct Write {
+        std::string key;
+        std::string value;
+        std::shared_ptr<WriteAck> ack; // Null for fire-and-forget
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    Store& store;
+    std::mutex mtx;
+    std::condition_variable workCv;
+    std::condition_variable drainedCv;
+    std::deque<Write> queue;
+    bool applying = false;
+    bool stopping = false;
+    uint64_t applied = 0;
+    double lastBatchLagMs = 0, maxBatchLagMs = 0;
+    std::thread worker;
+
+    void apply(std::vector<Write>& batch) {
+        std::vector<std::pair<std::string, std::string>> entries;
+        std::vector<uint32_t> indices(batch.size());
+        entries.reserve(batch.size());
+        for (uint32_t i = 0; i < batch.size(); ++i) {
+            entries.emplace_back(std::move(batch[i].key), std::move(batch[i].value));
+            indices[i] = i;
+        }
+        bool ok = replication::applied([&] { return store.putMany(entries, indices); });
+        for (Write& w : batch) {
+            if (!w.ack) continue;
+            if (ok) w.ack->ack();
+            else w.ack->fail(); // A partly applied batch fails every write in it
+        }
+    }
+
+    void run() {
+        std::vector<Write> batch;
+        std::unique_lock lock(mtx);
+        while (true) {
+            workCv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return; // Stopping and drained
+            size_t n = std::min(queue.size(), MAX_BATCH);
+            for (size_t i = 0; i < n; ++i) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            applying = true;
+            lock.unlock();
+
+            auto oldest = batch.front().enqueued;
+            apply(batch);
+            double lagMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oldest).count();
+
+            lock.lock();
+            applied += batch.size();
+            batch.clear();
+            applying = false;
+            lastBatchLagMs = lagMs;
+            maxBatchLagMs = std::max(maxBatchLagMs, lagMs);
+            drainedCv.notify_all();
+        }
+    }
+
+public:
+    explicit ReplicationWorker(Store& target) : store(target) {
+        worker = std::thread(&ReplicationWorker::run, this);
+    }
+
+    ReplicationWorker(const ReplicationWorker&) = delete;
+    ReplicationWorker& operator=(const ReplicationWorker&) = delete;
+
+    // Applies everything still queued before returning
+    ~ReplicationWorker() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        workCv.notify_one();
+        worker.join();
+    }
+
+    void enqueuePut(const std::string& key, const std::string& value, std::shared_ptr<WriteAck> ack = nullptr) {
+        {
+            std::lock_guard lock(mtx);
+            queue.push_back(Write{key, value, std::move(ack), std::chrono::steady_clock::now()});
+        }
+        workCv.notify_one();
+    }
+
+    // Blocks until every write queued so far has been applied
+    void drain() {
+        std::unique_lock lock(mtx);
+        drainedCv.wait(lock, [this] { return queue.empty() && !applying; });
+    }
+
+    ReplicaLag lag() {
+        std::lock_guard lock(mtx);
+        ReplicaLag l;
+        l.queued = queue.size();
+        l.applied = applied;
+        if (!queue.empty()) {
+            l.oldestPendingMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - queue.front().enqueued).count();
+        }
+        l.lastBatchLagMs = lastBatchLagMs;
+        l.maxBatchLagMs = maxBatchLagMs;
+        return l;
+    }
+};
+
+/*
+Sliding window of recent replica read latencies. Hedged reads wait this
+window's chosen percentile before asking another replica, so only the
+slowest few percent of reads pay for a second request.
+*/
+
+class LatencyTracker {
+private:
+    static constexpr size_t WINDOW = 1024;
+    static constexpr size_t RECOMPUTE_EVERY = 64;
+
+    std::mutex mtx;
+    std::vector<double> samples; // Ring buffer, microseconds
+    size_t next = 0;
+    size_t sinceRecompute = 0;
+    double percentile;
+    double cached;
+
+public:
+    LatencyTracker(double pct = 0.95, double initialMicros = 1000) : percentile(pct), cached(initialMicros) {}
+
+    void record(double micros) {
+        std::lock_guard lock(mtx);
+        if (samples.size() < WINDOW) samples.push_back(micros);
+        else samples[next] = micros;
+        next = (next + 1) % WINDOW;
+        if (++sinceRecompute >= RECOMPUTE_EVERY) {
+            sinceRecompute = 0;
+            std::vector<double> sorted = samples;
+            size_t rank = std::min(sorted.size() - 1, (size_t)(percentile * sorted.size()));
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            cached = sorted[rank];
+        }
+    }
+
+    void setPercentile(double pct) {
+        std::lock_guard lock(mtx);
+        percentile = pct;
+        sinceRecompute = RECOMPUTE_EVERY; // Recompute on the next sample
+    }
+
+    double micros() {
+        std::lock_guard lock(mtx);
+        return cached;
+    }
+};
+
+// Small fixed pool that runs replica reads in parallel
+class ReadExecutor {
+private:
+    std::mutex mtx;
+    std::condition_variable workCv;
+    std::condition_variable idleCv;
+    std::deque<std::function<void()>> tasks;
+    size_t running = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void run() {
+        std::unique_lock lock(mtx);
+        while (true) {
+            workCv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            ++running;
+            lock.unlock();
+            task();
+            lock.lock();
+            --running;
+            if (tasks.empty() && running == 0) idleCv.notify_all();
+        }
+    }
+
+public:
+    // Sized well above the replica count: a losing hedge keeps its thread
+    // until the slow replica answers
+    explicit ReadExecutor(size_t threadCount = 32) {
+        for (size_t i = 0; i < threadCount; ++i) threads.emplace_back(&ReadExecutor::run, this);
+    }
+
+    ReadExecutor(const ReadExecutor&) = delete;
+    ReadExecutor& operator=(const ReadExecutor&) = delete;
+
+    ~ReadExecutor() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        workCv.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard lock(mtx);
+            tasks.push_back(std::move(task));
+        }
+        workCv.notify_one();
+    }
+
+    // Waits for stragglers (e.g. the losing side of a hedge) to finish
+    void waitIdle() {
+        std::unique_lock lock(mtx);
+        idleCv.wait(lock, [this] { return tasks.empty() && running == 0; });
+    }
+};
+
+#endif // REPLICATION_H
@@ -0,0 +1,203 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Bounded lock-free ring buffers. Capacity is rounded up to a power of two
+so a slot index is a mask, not a division. Head and tail indices count up
+forever and live on separate cache lines, so producers and consumers
+don't invalidate each other's line on every operation. A full buffer
+rejects the push; nothing is overwritten.
+
+  - SpscRingBuffer: one producer thread, one consumer thread. tryPush and
+    tryPop are wait-free. Each side caches the other's index and reloads
+    it only when the buffer looks full (or empty).
+  - MpmcRingBuffer: any number of producers and consumers (Vyukov's
+    bounded queue). Each cell carries a sequence number that says whose
+    turn it is, so a thread claims a cell with one CAS on the shared index
+    and no thread ever waits on a lock.
+
+tryPush / tryPop return false when full / empty. push / pop spin, then
+yield, until they succeed. T must be default-constructible and
+move-assignable.
+*/
+
+namespace ringbuffer {
+
+constexpr size_t CACHE_LINE = 64;
+
+inline size_t roundUpPow2(size_t n) {
+    size_t capacity = 2;
+    while (capacity < n) capacity <<= 1;
+    return capacity;
+}
+
+// Busy-waits briefly, then gives up the CPU so an oversubscribed machine
+// still makes progress
+inline void backoff(int& spins) {
+    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace ringbuffer
+
+template <typename T>
+class SpscRingBuffer {
+private:
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+
+    alignas(ringbuffer::CACHE_LINE) std::atomic<size_t> head{0}; // Next slot to pop; written by the consumer
+    size_t cachedTail = 0;                                        // Consumer's last view of tail
+
+    alignas(ringbuffer::CACHE_LINE) std::atomic<size_t> tail{0}; // Next slot to push; written by the producer
+    size_t cachedHead = 0;                                        // Producer's last view of head
+
+public:
+    explicit SpscRingBuffer(size_t minCapacity)
+        : mask(ringbuffer::roundUpPow2(minCapacity) - 1), slots(new T[mask + 1]) {}
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // Producer thread only
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = std::forward<U>(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool tryPop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        for (int spins = 0; !tryPush(std::forward<U>(value));) ringbuffer::backoff(spins);
+    }
+
+    T pop() {
+        T out;
+        for (int spins = 0; !tryPop(out);) ringbuffer::backoff(spins);
+        return out;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Exact only when neither side is running
+    size_t sizeApprox() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+template <typename T>
+class MpmcRingBuffer {
+private:
+    // A cell is free for the push at position pos when sequence == pos,
+    // and holds that push's value for the pop at pos when sequence == pos + 1
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(ringbuffer::CACHE_LINE) std::atomic<size_t> enqueuePos{0};
+    alignas(ringbuffer::CACHE_LINE) std::atomic<size_t> dequeuePos{0};
+
+public:
+    explicit MpmcRingBuffer(size_t minCapacity)
+        : mask(ringbuffer::roundUpPow2(minCapacity) - 1), cells(new Cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcRingBuffer(const MpmcRingBuffer&) = delete;
+    MpmcRingBuffer& operator=(const MpmcRingBuffer&) = delete;
+
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // The cell still holds the value pushed a lap ago
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed); // Another producer took pos
+            }
+        }
+        cell->value = std::forward<U>(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // Nothing pushed at pos yet
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release); // Free for the push one lap later
+        return true;
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        for (int spins = 0; !tryPush(std::forward<U>(value));) ringbuffer::backoff(spins);
+    }
+
+    T pop() {
+        T out;
+        for (int spins = 0; !tryPop(out);) ringbuffer::backoff(spins);
+        return out;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    size_t sizeApprox() const {
+        size_t tail = enqueuePos.load(std::memory_order_acquire), head = dequeuePos.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+};
+
+#endif // RING_BUFFER_H
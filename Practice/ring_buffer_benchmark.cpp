@@ -0,0 +1,110 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "ring_buffer.h"
+
+/*
+Ops/sec through each ring buffer at each thread count, against a
+mutex-guarded std::queue of the same capacity. "threads" is producers +
+consumers, split evenly; every item pushed is popped, and the consumers'
+checksum is compared with what was pushed. One op is a push or a pop.
+
+Build: g++ -std=c++17 -O2 -pthread ring_buffer_benchmark.cpp -o ring_buffer_benchmark
+*/
+
+using namespace std;
+using namespace std::chrono;
+
+const size_t CAPACITY = 1024;
+const uint64_t ITEMS = 4000000;
+
+// Bounded queue behind one mutex, for comparison
+class LockedQueue {
+private:
+    mutex mtx;
+    queue<uint64_t> items;
+    size_t limit;
+
+public:
+    explicit LockedQueue(size_t capacity) : limit(capacity) {}
+
+    bool tryPush(uint64_t value) {
+        lock_guard<mutex> lock(mtx);
+        if (items.size() >= limit) return false;
+        items.push(value);
+        return true;
+    }
+
+    bool tryPop(uint64_t& out) {
+        lock_guard<mutex> lock(mtx);
+        if (items.empty()) return false;
+        out = items.front();
+        items.pop();
+        return true;
+    }
+
+    void push(uint64_t value) {
+        for (int spins = 0; !tryPush(value);) ringbuffer::backoff(spins);
+    }
+
+    uint64_t pop() {
+        uint64_t out;
+        for (int spins = 0; !tryPop(out);) ringbuffer::backoff(spins);
+        return out;
+    }
+};
+
+// Runs pairs producer/consumer pairs over ITEMS items; returns ops/sec
+template <typename Queue>
+double run(Queue& queue, int pairs) {
+    atomic<uint64_t> checksum{0};
+    vector<thread> threads;
+    uint64_t perProducer = ITEMS / pairs;
+    auto start = steady_clock::now();
+    for (int p = 0; p < pairs; ++p) {
+        threads.emplace_back([&queue, p, perProducer] {
+            for (uint64_t i = 0; i < perProducer; ++i) queue.push(p * perProducer + i + 1);
+        });
+        threads.emplace_back([&queue, &checksum, perProducer] {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < perProducer; ++i) sum += queue.pop();
+            checksum.fetch_add(sum, memory_order_relaxed);
+        });
+    }
+    for (auto& t : threads) t.join();
+    double secs = duration<double>(steady_clock::now() - start).count();
+
+    uint64_t items = perProducer * pairs;
+    if (checksum.load() != items * (items + 1) / 2) cout << "checksum mismatch!" << endl;
+    return 2 * items / secs;
+}
+
+void report(const char* name, int threads, double opsPerSec) {
+    cout << left << setw(8) << name << right << setw(8) << threads << setw(14) << fixed << setprecision(0)
+         << opsPerSec << setw(16) << opsPerSec / threads << endl;
+}
+
+int main() {
+    cout << left << setw(8) << "queue" << right << setw(8) << "threads" << setw(14) << "ops/s"
+         << setw(16) << "ops/s/thread" << endl;
+
+    {
+        SpscRingBuffer<uint64_t> spsc(CAPACITY);
+        report("spsc", 2, run(spsc, 1));
+    }
+    for (int pairs : {1, 2, 4, 8}) {
+        MpmcRingBuffer<uint64_t> mpmc(CAPACITY);
+        report("mpmc", 2 * pairs, run(mpmc, pairs));
+    }
+    for (int pairs : {1, 2, 4, 8}) {
+        LockedQueue locked(CAPACITY);
+        report("mutex", 2 * pairs, run(locked, pairs));
+    }
+    return 0;
+}
@@ -0,0 +1,360 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <optional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+Compact on-disk snapshot of a node's contents, laid out so it can be
+mmap()ed and queried in place while the in-memory tables are rebuilt.
+
+Layout (little-endian):
+  Header   magic "KVSNAP01" | u32 entryCount | u32 blockCount
+           | u64 blockIndexOffset | u64 recencyOffset
+  Data     entries sorted by key: u32 keyLength | u32 valueLength | key | value
+  Block    u64 offset of every BLOCK_ENTRIES-th entry (first entry of each
+  index    block), for a binary search over block first keys
+  Recency  u64 entry offsets in most- to least-recently-used order, so an
+           LRU cache can be rebuilt with its eviction order intact
+
+A lookup is a binary search over the block index followed by a scan of
+at most BLOCK_ENTRIES entries, touching only a few pages of the file.
+*/
+
+class Snapshot {
+private:
+    static constexpr char MAGIC[8] = {'K', 'V', 'S', 'N', 'A', 'P', '0', '1'};
+    static constexpr size_t HEADER = 8 + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    static constexpr uint32_t BLOCK_ENTRIES = 16;
+
+    const char* base = nullptr;
+    size_t length = 0;
+    uint64_t dataEnd = 0; // Entries lie in [HEADER, dataEnd)
+    uint32_t entryCount = 0;
+    uint32_t blockCount = 0;
+    const char* blockIndex = nullptr;
+    const char* recency = nullptr;
+
+    template <typename T>
+    static T load(const char* p) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    template <typename T>
+    static void store(std::string& out, T v) {
+        out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    std::string_view keyAt(uint64_t offset) const {
+        return std::string_view(base + offset + 8, load<uint32_t>(base + offset));
+    }
+
+    std::string_view valueAt(uint64_t offset) const {
+        uint32_t keyLength = load<uint32_t>(base + offset);
+        return std::string_view(base + offset + 8 + keyLength, load<uint32_t>(base + offset + 4));
+    }
+
+    uint64_t blockOffset(uint32_t block) const {
+        return load<uint64_t>(blockIndex + block * sizeof(uint64_t));
+    }
+
+    // Stored offsets are not trusted: the entry at offset, lengths
+    // included, must lie wholly inside the data region
+    bool validEntry(uint64_t offset) const {
+        if (offset < HEADER || offset > dataEnd || dataEnd - offset < 8) return false;
+        uint64_t size = 8 + (uint64_t)load<uint32_t>(base + offset) + load<uint32_t>(base + offset + 4);
+        return size <= dataEnd - offset;
+    }
+
+    static bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static bool syncParentDir(const std::string& path) {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return false;
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+public:
+    // Writes entries, given in most- to least-recently-used order (any
+    // order for stores without recency), to path. Returns false on I/O error.
+    static bool write(const std::string& path, std::vector<std::pair<std::string, std::string>> entries) {
+        std::vector<uint32_t> byKey(entries.size());
+        for (uint32_t i = 0; i < byKey.size(); ++i) byKey[i] = i;
+        std::sort(byKey.begin(), byKey.end(), [&](uint32_t a, uint32_t b) {
+            return entries[a].first < entries[b].first;
+        });
+
+        std::string out(HEADER, '\0');
+        std::vector<uint64_t> offsetOf(entries.size());
+        std::vector<uint64_t> blocks;
+        for (uint32_t rank = 0; rank < byKey.size(); ++rank) {
+            const auto& [key, value] = entries[byKey[rank]];
+            offsetOf[byKey[rank]] = out.size();
+            if (rank % BLOCK_ENTRIES == 0) blocks.push_back(out.size());
+            store<uint32_t>(out, key.size());
+            store<uint32_t>(out, value.size());
+            out += key;
+            out += value;
+        }
+        uint64_t blockIndexOffset = out.size();
+        for (uint64_t offset : blocks) store<uint64_t>(out, offset);
+        uint64_t recencyOffset = out.size();
+        for (uint64_t offset : offsetOf) store<uint64_t>(out, offset);
+
+        std::memcpy(&out[0], MAGIC, 8);
+        uint32_t count = entries.size(), blockCount = blocks.size();
+        std::memcpy(&out[8], &count, 4);
+        std::memcpy(&out[12], &blockCount, 4);
+        std::memcpy(&out[16], &blockIndexOffset, 8);
+        std::memcpy(&out[24], &recencyOffset, 8);
+
+        // Write to a temp file and rename so readers never see a partial
+        // snapshot; the directory is synced so the rename survives a crash
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        bool ok = writeAll(fd, out.data(), out.size()) && ::fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        return syncParentDir(path);
+    }
+
+    explicit Snapshot(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open snapshot " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER) {
+            ::close(fd);
+            throw std::runtime_error("bad snapshot " + path);
+        }
+        length = st.st_size;
+        void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) throw std::runtime_error("cannot mmap snapshot " + path);
+        base = static_cast<const char*>(mapped);
+
+        uint64_t blockIndexOffset = load<uint64_t>(base + 16);
+        uint64_t recencyOffset = load<uint64_t>(base + 24);
+        entryCount = load<uint32_t>(base + 8);
+        blockCount = load<uint32_t>(base + 12);
+        if (std::memcmp(base, MAGIC, 8) != 0 || blockCount != (entryCount + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES ||
+            blockIndexOffset < HEADER || blockIndexOffset > length ||
+            (uint64_t)blockCount * 8 > length - blockIndexOffset ||
+            recencyOffset > length || (uint64_t)entryCount * 8 > length - recencyOffset) {
+            ::munmap(const_cast<char*>(base), length);
+            throw std::runtime_error("bad snapshot " + path);
+        }
+        dataEnd = blockIndexOffset;
+        blockIndex = base + blockIndexOffset;
+        recency = base + recencyOffset;
+        ::madvise(const_cast<char*>(base), length, MADV_WILLNEED);
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    ~Snapshot() {
+        if (base) ::munmap(const_cast<char*>(base), length);
+    }
+
+    // Points into the mapping; valid for the lifetime of the Snapshot.
+    // A corrupt entry on the way reads as a miss.
+    std::optional<std::string_view> find(std::string_view key) const {
+        if (blockCount == 0) return std::nullopt;
+        // Last block whose first key is <= key
+        uint32_t lo = 0, hi = blockCount;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (!validEntry(blockOffset(mid))) return std::nullopt;
+            if (keyAt(blockOffset(mid)) <= key) lo = mid;
+            else hi = mid;
+        }
+        uint64_t offset = blockOffset(lo);
+        uint32_t inBlock = std::min(BLOCK_ENTRIES, entryCount - lo * BLOCK_ENTRIES);
+        for (uint32_t i = 0; i < inBlock; ++i) {
+            if (!validEntry(offset)) return std::nullopt;
+            std::string_view k = keyAt(offset);
+            if (k == key) return valueAt(offset);
+            if (k > key) break;
+            offset += 8 + k.size() + valueAt(offset).size();
+        }
+        return std::nullopt;
+    }
+
+    // fn(key, value) from least- to most-recently-used, the order in which
+    // to re-insert into an LRU so the most recent entries end up in front.
+    // Corrupt entries are skipped.
+    template <typename Fn>
+    void forEachOldestFirst(Fn&& fn) const {
+        for (uint32_t i = entryCount; i-- > 0;) {
+            uint64_t offset = load<uint64_t>(recency + i * sizeof(uint64_t));
+            if (validEntry(offset)) fn(keyAt(offset), valueAt(offset));
+        }
+    }
+
+    size_t size() const { return entryCount; }
+};
+
+// Dumps any store with forEach(key, value) to a snapshot file
+template <typename Store>
+bool saveSnapshot(Store& store, const std::string& path) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    store.forEach([&](std::string_view key, std::string_view value) {
+        entries.emplace_back(std::string(key), std::string(value));
+    });
+    return Snapshot::write(path, std::move(entries));
+}
+
+/*
+Store wrapper for fast warm-up after a restart. Reads are served from the
+mmapped snapshot straight away; a background thread copies the snapshot
+into the in-memory Store, after which the snapshot is dropped and the
+wrapper is a plain pass-through.
+
+While warming, keys written or removed by callers are remembered so the
+loader never overwrites them with stale snapshot data, and a removed key
+is not resurrected from the snapshot on read. Misses share warmMutex, so
+concurrent misses read the snapshot in parallel; only writes and the
+loader's batches take it exclusively.
+*/
+
+template <typename Store>
+class WarmingStore {
+private:
+    Store store;
+    std::shared_ptr<const Snapshot> snapshot;  // Null once loaded; readers hold their own reference
+    std::atomic<bool> warming{false};
+    std::shared_mutex warmMutex;               // Exclusive for loader batches and caller writes
+    std::unordered_set<std::string> touched;   // Keys written/removed while warming
+    std::thread loader;
+
+    void load() {
+        std::vector<std::pair<std::string, std::string>> batch;
+        auto flush = [&] {
+            std::lock_guard lock(warmMutex);
+            for (auto& [key, value] : batch) {
+                if (!touched.count(key)) store.put(key, value);
+            }
+            batch.clear();
+        };
+        snapshot->forEachOldestFirst([&](std::string_view key, std::string_view value) {
+            batch.emplace_back(std::string(key), std::string(value));
+            if (batch.size() == 1024) flush();
+        });
+        flush();
+
+        std::lock_guard lock(warmMutex);
+        warming.store(false, std::memory_order_release);
+        touched.clear();
+        snapshot.reset();
+    }
+
+    // Records a caller write while warming; returns with warmMutex held if so
+    std::unique_lock<std::shared_mutex> noteWrite(const std::string& key) {
+        if (!warming.load(std::memory_order_acquire)) return {};
+        std::unique_lock lock(warmMutex);
+        if (warming.load(std::memory_order_relaxed)) touched.insert(key);
+        return lock;
+    }
+
+public:
+    WarmingStore() = default;
+
+    // Serves from the snapshot at path immediately and loads it in the background
+    explicit WarmingStore(const std::string& snapshotPath) : snapshot(std::make_shared<const Snapshot>(snapshotPath)) {
+        warming.store(true);
+        loader = std::thread(&WarmingStore::load, this);
+    }
+
+    ~WarmingStore() {
+        if (loader.joinable()) loader.join();
+    }
+
+    bool isWarming() const { return warming.load(std::memory_order_acquire); }
+
+    void put(const std::string& key, const std::string& value) {
+        auto lock = noteWrite(key);
+        store.put(key, value);
+    }
+
+    void remove(const std::string& key) {
+        auto lock = noteWrite(key);
+        store.remove(key);
+    }
+
+    std::optional<std::string> tryGet(std::string_view key) {
+        if (auto value = store.tryGet(key)) return value;
+        if (!warming.load(std::memory_order_acquire)) return std::nullopt;
+
+        std::shared_ptr<const Snapshot> snap;
+        {
+            std::shared_lock lock(warmMutex);
+            if (!warming.load(std::memory_order_relaxed)) return store.tryGet(key);
+            if (touched.count(std::string(key))) return store.tryGet(key);
+            snap = snapshot;
+        }
+        // Not written since warming began, so the snapshot is current for key
+        if (auto value = snap->find(key)) return std::string(*value);
+        return std::nullopt;
+    }
+
+    std::string get(const std::string& key) {
+        return tryGet(key).value_or("Key Not Found");
+    }
+
+    void getMany(const std::vector<std::string>& keys, const std::vector<uint32_t>& indices,
+                 std::vector<std::string>& out, std::vector<bool>& found) {
+        for (uint32_t i : indices) {
+            if (auto value = tryGet(keys[i])) {
+                out[i] = std::move(*value);
+                found[i] = true;
+            }
+        }
+    }
+
+    void putMany(const std::vector<std::pair<std::string, std::string>>& entries,
+                 const std::vector<uint32_t>& indices) {
+        for (uint32_t i : indices) put(entries[i].first, entries[i].second);
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) { store.forEach(std::forward<Fn>(fn)); }
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,171 @@
+#ifndef STABLE_HASH_H
+#define STABLE_HASH_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+/*
+Stable 64-bit hashing (XXH64) for ring placement.
+
+std::hash<std::string> is implementation-defined, so node and key
+positions could differ between binaries built against different standard
+libraries. XXH64 is fully specified, so the same key lands on the same
+ring position everywhere. Words are read little-endian via memcpy, which
+matches the reference output on the x86/ARM targets we build for.
+
+hashBatch() hashes many keys at once. Short keys (< 32 bytes, the common
+case for our key names) are processed LANES at a time with one state
+per lane, and the per-word mixing and final avalanche run as uniform
+loops across the lanes so the compiler can vectorize or at least
+interleave them. Longer keys fall back to the scalar path.
+*/
+
+namespace stablehash {
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+// One 8-byte word of the short-input tail
+inline uint64_t mixWord(uint64_t h, uint64_t word) {
+    h ^= round(0, word);
+    return rotl(h, 27) * PRIME1 + PRIME4;
+}
+
+// Remaining 0..7 bytes after the last full word
+inline uint64_t mixTail(uint64_t h, const char* p, size_t len) {
+    if (len >= 4) {
+        h ^= (uint64_t)read32(p) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (uint64_t)(uint8_t)*p * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+        ++p;
+        --len;
+    }
+    return h;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t hash64(const char* p, size_t len, uint64_t seed = 0) {
+    const char* end = p + len;
+    uint64_t h;
+    if (len >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        const char* limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += len;
+    while (end - p >= 8) {
+        h = mixWord(h, read64(p));
+        p += 8;
+    }
+    return avalanche(mixTail(h, p, end - p));
+}
+
+inline uint64_t hash64(const std::string& s, uint64_t seed = 0) {
+    return hash64(s.data(), s.size(), seed);
+}
+
+constexpr size_t LANES = 8;
+
+// out[i] = hash64(keys[i], seed) for i in [0, count)
+inline void hashBatch(const std::string* keys, size_t count, uint64_t* out, uint64_t seed = 0) {
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        size_t words[LANES];
+        size_t maxWords = 0;
+        bool allShort = true;
+        for (size_t l = 0; l < LANES; ++l) {
+            allShort &= keys[i + l].size() < 32;
+            words[l] = keys[i + l].size() / 8;
+            maxWords = std::max(maxWords, words[l]);
+        }
+        if (!allShort) {
+            for (size_t l = 0; l < LANES; ++l) out[i + l] = hash64(keys[i + l], seed);
+            continue;
+        }
+
+        uint64_t h[LANES];
+        for (size_t l = 0; l < LANES; ++l) h[l] = seed + PRIME5 + keys[i + l].size();
+
+        for (size_t w = 0; w < maxWords; ++w) {
+            uint64_t in[LANES];
+            for (size_t l = 0; l < LANES; ++l) {
+                in[l] = w < words[l] ? read64(keys[i + l].data() + 8 * w) : 0;
+            }
+            for (size_t l = 0; l < LANES; ++l) {
+                uint64_t mixed = mixWord(h[l], in[l]);
+                h[l] = w < words[l] ? mixed : h[l];
+            }
+        }
+
+        for (size_t l = 0; l < LANES; ++l) {
+            const std::string& k = keys[i + l];
+            h[l] = mixTail(h[l], k.data() + 8 * words[l], k.size() - 8 * words[l]);
+        }
+        for (size_t l = 0; l < LANES; ++l) out[i + l] = avalanche(h[l]);
+    }
+    for (; i < count; ++i) out[i] = hash64(keys[i], seed);
+}
+
+} // namespace stablehash
+
+#endif // STABLE_HASH_H
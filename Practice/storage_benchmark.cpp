@@ -0,0 +1,72 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include "lsm_store.h"
+
+/*
+Miss-path latency of the LSM store behind the LRU cache: what a cache
+miss pays to reach storage. Loads KEY_COUNT keys (several flushes and
+compactions), then times random point lookups for keys that exist and
+for keys that do not (the latter should mostly stop at bloom filters).
+
+Build: g++ -std=c++17 -O2 -pthread storage_benchmark.cpp -o storage_benchmark
+*/
+
+using namespace std;
+using namespace std::chrono;
+
+const int KEY_COUNT = 200000;
+const int LOOKUPS = 100000;
+
+void report(const string& label, vector<double>& micros) {
+    sort(micros.begin(), micros.end());
+    auto pct = [&](double p) { return micros[min(micros.size() - 1, (size_t)(p * micros.size()))]; };
+    cout << left << setw(10) << label << right << fixed << setprecision(2)
+         << setw(10) << pct(0.50) << setw(10) << pct(0.90) << setw(10) << pct(0.99)
+         << setw(10) << pct(0.999) << setw(10) << micros.back() << endl;
+}
+
+int main() {
+    string dir = "/tmp/storage_benchmark";
+    filesystem::remove_all(dir);
+    LsmStore store(dir, 1 << 20);
+
+    auto start = steady_clock::now();
+    string value(100, 'v');
+    for (int i = 0; i < KEY_COUNT; ++i) store.put("user" + to_string(i), value);
+    store.flush();
+    double loadSecs = duration<double>(steady_clock::now() - start).count();
+    LsmStats loaded = store.stats();
+    cout << KEY_COUNT << " keys loaded in " << fixed << setprecision(2) << loadSecs << " s ("
+         << loaded.flushes << " flushes, " << loaded.compactions << " compactions, "
+         << store.runCount() << " runs)\n\n";
+
+    cout << left << setw(10) << "lookup" << right << setw(10) << "p50 us" << setw(10) << "p90 us"
+         << setw(10) << "p99 us" << setw(10) << "p99.9 us" << setw(10) << "max us" << endl;
+
+    mt19937 rng(42);
+    for (bool present : {true, false}) {
+        LsmStats before = store.stats();
+        vector<double> micros;
+        micros.reserve(LOOKUPS);
+        size_t found = 0;
+        for (int i = 0; i < LOOKUPS; ++i) {
+            string key = (present ? "user" : "absent") + to_string(rng() % KEY_COUNT);
+            auto t0 = steady_clock::now();
+            found += store.get(key).has_value();
+            micros.push_back(duration<double, micro>(steady_clock::now() - t0).count());
+        }
+        report(present ? "hit" : "absent", micros);
+        LsmStats after = store.stats();
+        cout << "          found " << found << ", block reads/lookup "
+             << setprecision(3) << (double)(after.diskReads - before.diskReads) / LOOKUPS
+             << ", bloom skips/lookup " << (double)(after.bloomSkips - before.bloomSkips) / LOOKUPS << endl;
+    }
+    filesystem::remove_all(dir);
+    return 0;
+}
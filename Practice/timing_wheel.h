@@ -0,0 +1,171 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Hierarchical timing wheel (Varghese & Lauck) over integer ticks.
+
+LEVELS wheels of SLOTS slots each; level l covers deadlines whose tick
+first differs from the current tick in base-SLOTS digit l. A timer sits
+in the slot named by that digit of its deadline. When the lower digits of
+the current tick roll over to zero, the level-l slot for the new digit is
+cascaded: its timers move down to the level of their next differing digit.
+A timer reaches level 0 by its deadline tick and fires there.
+
+  - schedule / cancel: O(1), an intrusive list insert / unlink
+  - advance: O(1) per tick plus O(1) per timer per level it cascades
+    through (at most LEVELS times over its lifetime)
+
+Deadlines more than SLOTS^LEVELS ticks out wait on an overflow list that
+is re-filed each time the top level wraps. advance() skips runs of ticks
+in which nothing can fire or cascade, so a sparse wheel (or one holding
+only far-off timers) is cheap to move across long gaps.
+
+Timers live in a pool indexed by Handle; freed nodes are reused, so the
+wheel allocates only while it grows.
+*/
+
+template <typename Id>
+class TimingWheel {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle NO_HANDLE = UINT32_MAX;
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t OVERFLOW = LEVELS * SLOTS; // List index of the overflow list
+
+    struct Timer {
+        Id id;
+        uint64_t deadline;
+        Handle prev, next;
+        uint32_t list; // Slot list the timer is on
+    };
+
+    std::vector<Timer> timers;
+    std::vector<Handle> freeTimers;
+    std::vector<Handle> heads = std::vector<Handle>(LEVELS * SLOTS + 1, NO_HANDLE);
+    size_t perLevel[LEVELS + 1] = {}; // Timers on each level's slots, overflow last
+    uint64_t current;
+    size_t scheduled = 0;
+
+    static uint32_t digit(uint64_t tick, int level) {
+        return (uint32_t)(tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+    }
+
+    void link(Handle h) {
+        Timer& t = timers[h];
+        uint64_t differing = t.deadline ^ current;
+        int level = 0;
+        while (level < LEVELS && (differing >> ((level + 1) * SLOT_BITS)) != 0) ++level;
+        t.list = level == LEVELS ? OVERFLOW : level * SLOTS + digit(t.deadline, level);
+        ++perLevel[level];
+        t.prev = NO_HANDLE;
+        t.next = heads[t.list];
+        if (t.next != NO_HANDLE) timers[t.next].prev = h;
+        heads[t.list] = h;
+    }
+
+    void unlink(Handle h) {
+        Timer& t = timers[h];
+        if (t.prev != NO_HANDLE) timers[t.prev].next = t.next;
+        else heads[t.list] = t.next;
+        if (t.next != NO_HANDLE) timers[t.next].prev = t.prev;
+        --perLevel[t.list / SLOTS];
+    }
+
+    // Re-files every timer on a list against the current tick
+    void cascade(uint32_t list) {
+        Handle h = heads[list];
+        heads[list] = NO_HANDLE;
+        while (h != NO_HANDLE) {
+            Handle next = timers[h].next;
+            --perLevel[list / SLOTS];
+            link(h);
+            h = next;
+        }
+    }
+
+public:
+    explicit TimingWheel(uint64_t startTick = 0) : current(startTick) {}
+
+    // Fires at the first advance() that reaches deadline; a deadline in the
+    // past fires on the next tick
+    Handle schedule(uint64_t deadline, Id id) {
+        Handle h;
+        if (!freeTimers.empty()) {
+            h = freeTimers.back();
+            freeTimers.pop_back();
+        } else {
+            h = (Handle)timers.size();
+            timers.emplace_back();
+        }
+        timers[h].id = id;
+        timers[h].deadline = deadline > current ? deadline : current + 1;
+        link(h);
+        ++scheduled;
+        return h;
+    }
+
+    // h must be scheduled and not yet fired
+    void cancel(Handle h) {
+        unlink(h);
+        freeTimers.push_back(h);
+        --scheduled;
+    }
+
+    // Moves the wheel to now, calling expire(id) for every timer due by
+    // then, in deadline order (timers due on the same tick in any order)
+    template <typename Fn>
+    size_t advance(uint64_t now, Fn&& expire) {
+        if (scheduled == 0) {
+            if (now > current) current = now;
+            return 0;
+        }
+        size_t fired = 0;
+        while (current < now) {
+            // Below the lowest non-empty level nothing fires or cascades
+            // until that level's next boundary
+            int lowest = 0;
+            while (perLevel[lowest] == 0) ++lowest;
+            if (lowest > 0) {
+                uint64_t boundary = ((current >> (lowest * SLOT_BITS)) + 1) << (lowest * SLOT_BITS);
+                current = std::min(now, boundary - 1);
+                if (current == now) break;
+            }
+            ++current;
+            int top = 0;
+            while (top < LEVELS - 1 && digit(current, top) == 0) ++top;
+            if (top == LEVELS - 1 && digit(current, top) == 0) cascade(OVERFLOW);
+            for (int level = top; level > 0; --level) cascade(level * SLOTS + digit(current, level));
+
+            uint32_t list = digit(current, 0);
+            Handle h = heads[list];
+            heads[list] = NO_HANDLE;
+            while (h != NO_HANDLE) {
+                Handle next = timers[h].next;
+                --perLevel[0];
+                Id id = std::move(timers[h].id); // expire() may schedule and grow the pool
+                freeTimers.push_back(h);
+                --scheduled;
+                ++fired;
+                expire(id);
+                h = next;
+            }
+            if (scheduled == 0 && current < now) current = now; // Nothing left to walk past
+        }
+        return fired;
+    }
+
+    uint64_t now() const { return current; }
+    size_t size() const { return scheduled; }
+};
+
+#endif // TIMING_WHEEL_H
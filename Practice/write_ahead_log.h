@@ -0,0 +1,348 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <optional>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "stable_hash.h"
+#include "key_value_store.h"
+
+/*
+Append-only write-ahead log for one node, with group commit.
+
+Record layout (little-endian):
+  u32 bodyLength | u64 checksum(body) | body
+  body = u8 op | u32 keyLength | u32 valueLength | key | value
+
+append() only encodes the record into an in-memory buffer under a mutex
+and returns its log sequence number (LSN); the flusher thread writes the
+buffer out and, depending on the durability level, fsyncs it. Callers
+that need durability wait on waitDurable(lsn): every writer that queued
+up while the previous fsync was in flight is covered by the next one,
+so N concurrent writers share one fsync instead of paying N.
+
+Durability levels:
+  NONE         - write() to the page cache, never fsync (survives a
+                 process crash, not a power loss)
+  PERIODIC     - flusher writes and fsyncs every flushInterval; callers
+                 never wait (bounded loss window)
+  GROUP_COMMIT - callers wait until their record is fsynced, sharing
+                 fsyncs with concurrent writers
+  SYNC         - write + fsync inline for every record
+
+Recovery reads records front to back and stops at the first short or
+corrupt record (a torn write from a crash), truncating the file there.
+
+A failed write or fdatasync is sticky: the records it covered never
+count as durable, later append()s are refused, and waitDurable() reports
+the failure. The log tail may be torn at that point, so nothing is
+appended after it.
+*/
+
+enum class Durability { NONE, PERIODIC, GROUP_COMMIT, SYNC };
+
+class WriteAheadLog {
+public:
+    enum Op : uint8_t { PUT = 1, REMOVE = 2 };
+
+private:
+    static constexpr size_t HEADER = sizeof(uint32_t) + sizeof(uint64_t);
+
+    int fd = -1;
+    Durability durability;
+    std::chrono::milliseconds flushInterval;
+
+    std::mutex mtx;
+    std::condition_variable pendingCv;  // Flusher waits for work
+    std::condition_variable durableCv;  // Writers wait for their LSN
+    std::string pending;                // Encoded records not yet written
+    uint64_t appendedLsn = 0;
+    uint64_t durableLsn = 0;
+    int error = 0;                      // First write/fdatasync errno; sticky
+    bool stopping = false;
+    std::thread flusher;
+
+    static void encode(std::string& out, Op op, std::string_view key, std::string_view value) {
+        uint32_t keyLength = key.size(), valueLength = value.size();
+        uint32_t bodyLength = 1 + 2 * sizeof(uint32_t) + keyLength + valueLength;
+        size_t start = out.size();
+        out.resize(start + HEADER + bodyLength);
+        char* p = &out[start + HEADER];
+        char* body = p;
+        *p++ = (char)op;
+        std::memcpy(p, &keyLength, sizeof(keyLength));
+        p += sizeof(keyLength);
+        std::memcpy(p, &valueLength, sizeof(valueLength));
+        p += sizeof(valueLength);
+        if (keyLength != 0) std::memcpy(p, key.data(), keyLength);
+        if (valueLength != 0) std::memcpy(p + keyLength, value.data(), valueLength);
+
+        uint64_t checksum = stablehash::hash64(body, bodyLength);
+        std::memcpy(&out[start], &bodyLength, sizeof(bodyLength));
+        std::memcpy(&out[start + sizeof(bodyLength)], &checksum, sizeof(checksum));
+    }
+
+    // Returns 0 or the errno of the failed call
+    int writeAll(const std::string& bytes) {
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno;
+            }
+            written += n;
+        }
+        return 0;
+    }
+
+    int sync() {
+        while (::fdatasync(fd) != 0) {
+            if (errno != EINTR) return errno;
+        }
+        return 0;
+    }
+
+    // write + fdatasync (unless NONE); returns 0 or the errno
+    int persist(const std::string& bytes) {
+        int err = writeAll(bytes);
+        if (err == 0 && durability != Durability::NONE) err = sync();
+        return err;
+    }
+
+    // Under mtx
+    void fail(int err) {
+        if (error != 0) return;
+        error = err;
+        errno = err;
+        std::perror("wal");
+        durableCv.notify_all();
+    }
+
+    void flushLoop() {
+        std::string batch;
+        std::unique_lock lock(mtx);
+        while (true) {
+            if (durability == Durability::PERIODIC) {
+                pendingCv.wait_for(lock, flushInterval, [this] { return stopping; });
+            } else {
+                pendingCv.wait(lock, [this] { return stopping || !pending.empty(); });
+            }
+            if (pending.empty()) {
+                if (stopping) return;
+                continue;
+            }
+            batch.swap(pending);
+            uint64_t batchLsn = appendedLsn;
+            if (error != 0) { // Already failed: the batch can never be durable
+                batch.clear();
+                continue;
+            }
+            lock.unlock();
+
+            int err = persist(batch);
+            batch.clear();
+
+            lock.lock();
+            if (err != 0) {
+                fail(err);
+                continue;
+            }
+            durableLsn = batchLsn;
+            durableCv.notify_all();
+        }
+    }
+
+public:
+    WriteAheadLog(const std::string& path, Durability level,
+                  std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+        : durability(level), flushInterval(interval) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw std::runtime_error("cannot open write-ahead log " + path);
+        if (durability != Durability::SYNC) flusher = std::thread(&WriteAheadLog::flushLoop, this);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        pendingCv.notify_one();
+        if (flusher.joinable()) flusher.join();
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Queues a record; returns its LSN, or nullopt once the log has failed.
+    // Under SYNC the record is already durable.
+    std::optional<uint64_t> append(Op op, std::string_view key, std::string_view value = {}) {
+        std::unique_lock lock(mtx);
+        if (error != 0) return std::nullopt;
+        if (durability == Durability::SYNC) {
+            std::string record;
+            encode(record, op, key, value);
+            if (int err = persist(record)) {
+                fail(err);
+                return std::nullopt;
+            }
+            durableLsn = ++appendedLsn;
+            return appendedLsn;
+        }
+        encode(pending, op, key, value);
+        ++appendedLsn;
+        if (durability != Durability::PERIODIC) pendingCv.notify_one();
+        return appendedLsn;
+    }
+
+    // Blocks until lsn is durable (GROUP_COMMIT only; other levels never
+    // wait). False if the log failed before lsn was made durable.
+    bool waitDurable(uint64_t lsn) {
+        std::unique_lock lock(mtx);
+        if (durability == Durability::GROUP_COMMIT) {
+            durableCv.wait(lock, [&] { return durableLsn >= lsn || error != 0; });
+        }
+        return durableLsn >= lsn || error == 0;
+    }
+
+    // errno of the failure that stopped the log, or 0
+    int failure() {
+        std::lock_guard lock(mtx);
+        return error;
+    }
+
+    // Replays every intact record through apply(op, key, value) and cuts
+    // off a torn tail. Call before the first append().
+    template <typename Apply>
+    size_t replay(Apply&& apply) {
+        std::lock_guard lock(mtx);
+        std::string data;
+        char chunk[1 << 16];
+        ::lseek(fd, 0, SEEK_SET);
+        for (ssize_t n; (n = ::read(fd, chunk, sizeof(chunk))) > 0;) data.append(chunk, n);
+
+        size_t offset = 0, records = 0;
+        while (data.size() - offset >= HEADER) {
+            uint32_t bodyLength;
+            uint64_t checksum;
+            std::memcpy(&bodyLength, &data[offset], sizeof(bodyLength));
+            std::memcpy(&checksum, &data[offset + sizeof(bodyLength)], sizeof(checksum));
+            if (bodyLength < 1 + 2 * sizeof(uint32_t) || data.size() - offset - HEADER < bodyLength) break;
+
+            const char* body = &data[offset + HEADER];
+            if (stablehash::hash64(body, bodyLength) != checksum) break;
+            uint32_t keyLength, valueLength;
+            std::memcpy(&keyLength, body + 1, sizeof(keyLength));
+            std::memcpy(&valueLength, body + 1 + sizeof(keyLength), sizeof(valueLength));
+            if (1 + 2 * sizeof(uint32_t) + (size_t)keyLength + valueLength != bodyLength) break;
+
+            const char* key = body + 1 + 2 * sizeof(uint32_t);
+            apply((Op)body[0], std::string_view(key, keyLength), std::string_view(key + keyLength, valueLength));
+            offset += HEADER + bodyLength;
+            ++records;
+        }
+        if (offset < data.size()) {
+            if (::ftruncate(fd, offset) != 0) std::perror("wal truncate");
+        }
+        return records;
+    }
+};
+
+/*
+KeyValueStore made durable by a per-node WriteAheadLog. The constructor
+replays the log to rebuild the in-memory table. Writes are logged and
+applied under one mutex so log order matches apply order; the wait for
+durability happens after the mutex is released so concurrent writers
+can share a group commit. Reads go straight to the in-memory store.
+*/
+
+class DurableKeyValueStore {
+private:
+    KeyValueStore store;
+    WriteAheadLog wal;
+    std::mutex orderMutex;
+
+public:
+    DurableKeyValueStore(const std::string& path, Durability level = Durability::GROUP_COMMIT)
+        : wal(path, level) {
+        wal.replay([this](WriteAheadLog::Op op, std::string_view key, std::string_view value) {
+            if (op == WriteAheadLog::PUT) store.put(std::string(key), std::string(value));
+            else store.remove(std::string(key));
+        });
+    }
+
+    // False if the write could not be logged (and was not applied) or was
+    // not made durable
+    bool put(const std::string& key, const std::string& value) {
+        std::optional<uint64_t> lsn;
+        {
+            std::lock_guard lock(orderMutex);
+            lsn = wal.append(WriteAheadLog::PUT, key, value);
+            if (!lsn) return false;
+            store.put(key, value);
+        }
+        return wal.waitDurable(*lsn);
+    }
+
+    bool remove(const std::string& key) {
+        std::optional<uint64_t> lsn;
+        {
+            std::lock_guard lock(orderMutex);
+            lsn = wal.append(WriteAheadLog::REMOVE, key);
+            if (!lsn) return false;
+            store.remove(key);
+        }
+        return wal.waitDurable(*lsn);
+    }
+
+    std::optional<std::string> tryGet(std::string_view key) const { return store.tryGet(key); }
+    KeyValueStore::ValueRef view(std::string_view key) const { return store.view(key); }
+    std::string get(const std::string& key) { return store.get(key); }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const { store.forEach(std::forward<Fn>(fn)); }
+
+    void getMany(const std::vector<std::string>& keys, const std::vector<uint32_t>& indices,
+                 std::vector<std::string>& out, std::vector<bool>& found) {
+        store.getMany(keys, indices, out, found);
+    }
+
+    // One group commit covers the whole batch. On a log failure only the
+    // entries logged before it are applied.
+    bool putMany(const std::vector<std::pair<std::string, std::string>>& entries,
+                 const std::vector<uint32_t>& indices) {
+        uint64_t lsn = 0;
+        {
+            std::lock_guard lock(orderMutex);
+            std::vector<uint32_t> logged;
+            logged.reserve(indices.size());
+            for (uint32_t i : indices) {
+                std::optional<uint64_t> appended = wal.append(WriteAheadLog::PUT, entries[i].first, entries[i].second);
+                if (!appended) break;
+                lsn = *appended;
+                logged.push_back(i);
+            }
+            store.putMany(entries, logged);
+            if (logged.size() != indices.size()) return false;
+        }
+        return wal.waitDurable(lsn);
+    }
+
+    // errno of the log failure, or 0
+    int failure() { return wal.failure(); }
+};
+
+#endif // WRITE_AHEAD_LOG_H